@@ -0,0 +1,553 @@
+#include "autotune.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <cpuid.h>
+#include <omp.h>
+
+static std::string trim(const std::string &s) {
+    size_t b = s.find_first_not_of(" \t\r\n");
+    size_t e = s.find_last_not_of(" \t\r\n");
+    return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+}
+
+// "48K", "2048K", "6M" as found in sysfs
+static long parse_size(const std::string &s) {
+    long value = std::atol(s.c_str());
+    if (s.find('K') != std::string::npos) value <<= 10;
+    if (s.find('M') != std::string::npos) value <<= 20;
+    return value;
+}
+
+static bool read_line(const std::string &path, std::string &line) {
+    std::ifstream in(path);
+    return in && std::getline(in, line);
+}
+
+static void set_level(CacheInfo &info, int level, long size) {
+    if (level == 1) info.l1d = size;
+    else if (level == 2) info.l2 = size;
+    else if (level == 3) info.l3 = size;
+}
+
+static bool caches_from_sysfs(CacheInfo &info) {
+    bool found = false;
+    for (int index = 0; index < 16; ++index) {
+        std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+        std::string level, type, size, line;
+        if (!read_line(dir + "level", level) || !read_line(dir + "type", type) || !read_line(dir + "size", size))
+            break;
+        if (type == "Instruction")
+            continue;
+        set_level(info, std::atoi(level.c_str()), parse_size(size));
+        if (read_line(dir + "coherency_line_size", line))
+            info.line = std::atoi(line.c_str());
+        found = true;
+    }
+    return found;
+}
+
+// Deterministic cache parameters: leaf 4 on Intel, 0x8000001D on AMD
+static bool caches_from_cpuid(CacheInfo &info) {
+    unsigned eax, ebx, ecx, edx;
+    unsigned leaf = 4;
+    if (!__get_cpuid_count(leaf, 0, &eax, &ebx, &ecx, &edx) || (eax & 0x1f) == 0) {
+        leaf = 0x8000001D;
+        if (!__get_cpuid_count(leaf, 0, &eax, &ebx, &ecx, &edx))
+            return false;
+    }
+    bool found = false;
+    for (unsigned sub = 0; sub < 16; ++sub) {
+        __cpuid_count(leaf, sub, eax, ebx, ecx, edx);
+        unsigned type = eax & 0x1f;
+        if (type == 0)
+            break;
+        if (type == 2)      // instruction cache
+            continue;
+        int level = (eax >> 5) & 0x7;
+        long ways = ((ebx >> 22) & 0x3ff) + 1;
+        long partitions = ((ebx >> 12) & 0x3ff) + 1;
+        long line = (ebx & 0xfff) + 1;
+        long sets = (long)ecx + 1;
+        set_level(info, level, ways * partitions * line * sets);
+        info.line = (int)line;
+        found = true;
+    }
+    return found;
+}
+
+CacheInfo detect_caches() {
+    CacheInfo info;
+    if (!caches_from_sysfs(info))
+        caches_from_cpuid(info);
+    return info;
+}
+
+std::string cpu_model() {
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(in, line))
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos)
+                return trim(line.substr(colon + 1));
+        }
+
+    unsigned regs[12];
+    if (__get_cpuid(0x80000000, &regs[0], &regs[1], &regs[2], &regs[3]) && regs[0] >= 0x80000004) {
+        for (unsigned i = 0; i < 3; ++i)
+            __get_cpuid(0x80000002 + i, &regs[4 * i], &regs[4 * i + 1], &regs[4 * i + 2], &regs[4 * i + 3]);
+        char brand[49] = {};
+        std::memcpy(brand, regs, 48);
+        return trim(brand);
+    }
+    return "unknown";
+}
+
+GemmConfig model_config(const CacheInfo &caches) {
+    GemmConfig cfg = gemm_fallback_config();
+    const long elem = sizeof(float);
+    int mr = gemm_mr(), nr = gemm_nr();
+
+    if (caches.l1d > 0)
+        cfg.kc = (int)std::min(512L, std::max(64L, caches.l1d / 2 / (nr * elem) / 8 * 8));
+    if (caches.l2 > 0)
+        cfg.mc = (int)std::min(384L, std::max((long)mr, caches.l2 / 2 / (cfg.kc * elem) / mr * mr));
+    if (caches.l3 > 0)
+        cfg.nc = (int)std::min(4096L, std::max(4L * nr, caches.l3 / 2 / (cfg.kc * elem) / nr * nr));
+    return cfg;
+}
+
+std::string tune_file_path() {
+    if (const char *path = std::getenv("GEMM_TUNE_FILE"))
+        return path;
+    const char *home = std::getenv("HOME");
+    return std::string(home ? home : ".") + "/.gemm_tune.conf";
+}
+
+bool load_tuned_config(GemmConfig &cfg) {
+    return load_config(tune_file_path(), cpu_model(), cfg);
+}
+
+using Section = std::vector<std::pair<std::string, std::string>>;
+
+// Key/value pairs of the model's section; false when the file has none
+static bool read_section(const std::string &path, const std::string &model, Section &entries) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+
+    bool in_section = false, matched = false;
+    std::string line;
+    while (std::getline(in, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+        if (line.front() == '[' && line.back() == ']') {
+            if (matched)
+                break;
+            in_section = trim(line.substr(1, line.size() - 2)) == model;
+            matched = in_section;
+            continue;
+        }
+        size_t eq = line.find('=');
+        if (in_section && eq != std::string::npos)
+            entries.emplace_back(trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+    }
+    return matched;
+}
+
+// Rewrites the file with the model's section updated: keys in updates
+// replace their old values, the section's other keys are kept (the blocking
+// and the cost model are saved separately), other CPUs' entries untouched
+static bool write_section(const std::string &path, const std::string &model, const Section &updates) {
+    Section entries;
+    read_section(path, model, entries);
+    for (const auto &u : updates) {
+        auto it = std::find_if(entries.begin(), entries.end(), [&](const auto &e) { return e.first == u.first; });
+        if (it != entries.end())
+            it->second = u.second;
+        else
+            entries.push_back(u);
+    }
+
+    std::vector<std::string> kept;
+    {
+        std::ifstream in(path);
+        std::string line;
+        bool skipping = false;
+        while (std::getline(in, line)) {
+            std::string t = trim(line);
+            if (!t.empty() && t.front() == '[' && t.back() == ']')
+                skipping = trim(t.substr(1, t.size() - 2)) == model;
+            if (!skipping)
+                kept.push_back(line);
+        }
+    }
+
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp);
+        if (!out)
+            return false;
+        for (const std::string &line : kept)
+            out << line << "\n";
+        out << "[" << model << "]\n";
+        for (const auto &e : entries)
+            out << e.first << " = " << e.second << "\n";
+        if (!out)
+            return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool load_config(const std::string &path, const std::string &model, GemmConfig &cfg) {
+    Section entries;
+    if (!read_section(path, model, entries))
+        return false;
+
+    GemmConfig found = gemm_fallback_config();
+    found.kc = found.mc = found.nc = 0;
+    for (const auto &e : entries) {
+        const std::string &key = e.first, &value = e.second;
+        if (key == "kc") found.kc = std::atoi(value.c_str());
+        else if (key == "mc") found.mc = std::atoi(value.c_str());
+        else if (key == "nc") found.nc = std::atoi(value.c_str());
+        else if (key == "loop_order") found.loop_order = value == "ir_jr" ? LOOP_IR_JR : LOOP_JR_IR;
+    }
+    if (found.kc > 0 && found.mc > 0 && found.nc > 0) {
+        cfg = found;
+        return true;
+    }
+    return false;
+}
+
+bool save_config(const std::string &path, const std::string &model, const GemmConfig &cfg) {
+    return write_section(path, model, {{"kc", std::to_string(cfg.kc)},
+                                       {"mc", std::to_string(cfg.mc)},
+                                       {"nc", std::to_string(cfg.nc)},
+                                       {"loop_order", cfg.loop_order == LOOP_IR_JR ? "ir_jr" : "jr_ir"}});
+}
+
+bool load_tuned_cost_model(GemmCostModel &cost) {
+    return load_cost_model(tune_file_path(), cpu_model(), cost);
+}
+
+bool load_cost_model(const std::string &path, const std::string &model, GemmCostModel &cost) {
+    Section entries;
+    if (!read_section(path, model, entries))
+        return false;
+
+    GemmCostModel found{-1.0, -1.0, -1.0, -1.0, -1.0};
+    for (const auto &e : entries) {
+        double value = std::atof(e.second.c_str());
+        if (e.first == "fork_join_us") found.fork_join_us = value;
+        else if (e.first == "core_gflops") found.core_gflops = value;
+        else if (e.first == "socket_gflops") found.socket_gflops = value;
+        else if (e.first == "core_gbs") found.core_gbs = value;
+        else if (e.first == "socket_gbs") found.socket_gbs = value;
+    }
+    if (found.fork_join_us >= 0.0 && found.core_gflops > 0.0 && found.socket_gflops > 0.0 && found.core_gbs > 0.0 &&
+        found.socket_gbs > 0.0) {
+        cost = found;
+        return true;
+    }
+    return false;
+}
+
+static std::string format_number(double value) {
+    std::ostringstream out;
+    out.precision(4);
+    out << value;
+    return out.str();
+}
+
+bool save_cost_model(const std::string &path, const std::string &model, const GemmCostModel &cost) {
+    return write_section(path, model, {{"fork_join_us", format_number(cost.fork_join_us)},
+                                       {"core_gflops", format_number(cost.core_gflops)},
+                                       {"socket_gflops", format_number(cost.socket_gflops)},
+                                       {"core_gbs", format_number(cost.core_gbs)},
+                                       {"socket_gbs", format_number(cost.socket_gbs)}});
+}
+
+bool load_tuned_tiles(TileConfig &tiles) {
+    return load_tiles(tune_file_path(), cpu_model(), tiles);
+}
+
+bool load_tiles(const std::string &path, const std::string &model, TileConfig &tiles) {
+    Section entries;
+    if (!read_section(path, model, entries))
+        return false;
+
+    TileConfig found{0, 0, 0, 0};
+    for (const auto &e : entries) {
+        int value = std::atoi(e.second.c_str());
+        if (e.first == "tile") found.tile = value;
+        else if (e.first == "tile_l1") found.l1 = value;
+        else if (e.first == "tile_l2") found.l2 = value;
+        else if (e.first == "tile_l3") found.l3 = value;
+    }
+    if (!tile_config_valid(found))
+        return false;
+    tiles = found;
+    return true;
+}
+
+bool save_tiles(const std::string &path, const std::string &model, const TileConfig &tiles) {
+    return write_section(path, model, {{"tile", std::to_string(tiles.tile)},
+                                       {"tile_l1", std::to_string(tiles.l1)},
+                                       {"tile_l2", std::to_string(tiles.l2)},
+                                       {"tile_l3", std::to_string(tiles.l3)}});
+}
+
+TileConfig tuned_tile_config() {
+    TileConfig tiles = default_tile_config();
+    load_tuned_tiles(tiles);
+    return tiles;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Best of five batches of empty parallel regions with one barrier each
+static double fork_join_us() {
+    const int reps = 1000;
+    double best = 1e30;
+    for (int batch = 0; batch <= 5; ++batch) {      // first batch is warm-up
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < reps; ++r) {
+            #pragma omp parallel
+            {
+                #pragma omp barrier
+            }
+        }
+        if (batch > 0)
+            best = std::min(best, seconds_since(start) / reps);
+    }
+    return best * 1e6;
+}
+
+// Best-of-three GB/s of summing data on a team of threads
+static double read_gbs(const std::vector<float> &data, int threads) {
+    double best = 1e30;
+    volatile float sink = 0.0f;
+    for (int t = 0; t <= 3; ++t) {
+        auto start = std::chrono::steady_clock::now();
+        float sum = 0.0f;
+        #pragma omp parallel for simd reduction(+ : sum) schedule(static) num_threads(threads)
+        for (size_t i = 0; i < data.size(); ++i)
+            sum += data[i];
+        if (t > 0)
+            best = std::min(best, seconds_since(start));
+        sink = sink + sum;
+    }
+    return data.size() * sizeof(float) / best * 1e-9;
+}
+
+// Best-of-three GFLOP/s of an n^3 sgemm on a team of threads
+static double sgemm_gflops(int n, int threads) {
+    std::vector<float> A((size_t)n * n, 1.0f), B((size_t)n * n, 0.5f), C((size_t)n * n);
+    const int team = omp_get_max_threads();
+    omp_set_num_threads(threads);
+    double best = 1e30;
+    for (int t = 0; t <= 3; ++t) {
+        auto start = std::chrono::steady_clock::now();
+        sgemm('N', 'N', n, n, n, 1.0f, A.data(), n, B.data(), n, 0.0f, C.data(), n);
+        if (t > 0)
+            best = std::min(best, seconds_since(start));
+    }
+    omp_set_num_threads(team);
+    return 2.0 * n * n * (double)n / best * 1e-9;
+}
+
+GemmCostModel calibrate_cost_model(bool verbose) {
+    GemmCostModel cost;
+    const int team = omp_get_max_threads();
+    cost.fork_join_us = team > 1 ? fork_join_us() : 0.0;
+
+    // The packed engine at sizes where packing is amortized; the team run
+    // plans with free fork/join so that it really uses every thread
+    gemm_set_cost_model(GemmCostModel{0.0, 1.0, 1e9, 1.0, 1e9});
+    cost.core_gflops = sgemm_gflops(512, 1);
+    cost.socket_gflops = team > 1 ? std::max(cost.core_gflops, sgemm_gflops(1024, team)) : cost.core_gflops;
+
+    // 128 MB, far past any L3, first touched by the team that reads it
+    std::vector<float> data;
+    data.reserve((size_t)32 << 20);
+    data.resize(data.capacity());
+    #pragma omp parallel for schedule(static)
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = 1.0f;
+    cost.core_gbs = read_gbs(data, 1);
+    cost.socket_gbs = team > 1 ? std::max(cost.core_gbs, read_gbs(data, team)) : cost.core_gbs;
+
+    if (verbose)
+        std::cout << "cost model: fork/join " << cost.fork_join_us << " us on " << team << " threads, sgemm "
+                  << cost.core_gflops << " GFLOP/s per thread, " << cost.socket_gflops << " GFLOP/s all threads, read "
+                  << cost.core_gbs << " GB/s per thread, " << cost.socket_gbs << " GB/s all threads\n";
+    gemm_set_cost_model(cost);
+    return gemm_get_cost_model();
+}
+
+// Best-of-trials GFLOP/s of one config on the trial problem
+static double trial(const GemmConfig &cfg, int n, int trials,
+                    const std::vector<float> &A, const std::vector<float> &B, std::vector<float> &C) {
+    gemm_set_config(cfg);
+    double best = 1e30;
+    for (int t = 0; t <= trials; ++t) {     // first run is warm-up
+        auto start = std::chrono::steady_clock::now();
+        sgemm('N', 'N', n, n, n, 1.0f, A.data(), n, B.data(), n, 0.0f, C.data(), n);
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (t > 0)
+            best = std::min(best, s);
+    }
+    return 2.0 * n * n * (double)n / best * 1e-9;
+}
+
+static void print_config(const GemmConfig &cfg) {
+    std::cout << "kc=" << cfg.kc << " mc=" << cfg.mc << " nc=" << cfg.nc
+              << " order=" << (cfg.loop_order == LOOP_IR_JR ? "ir_jr" : "jr_ir");
+}
+
+GemmConfig autotune(const AutotuneOptions &opt, double *best_gflops) {
+    const int n = opt.size;
+    const int mr = gemm_mr(), nr = gemm_nr();
+    std::vector<float> A((size_t)n * n, 1.0f), B((size_t)n * n, 0.5f), C((size_t)n * n);
+
+    const std::vector<int> kcs = {64, 128, 192, 256, 320, 384, 512};
+    std::vector<int> mcs, ncs;
+    for (int f : {4, 8, 12, 16, 24, 32})
+        mcs.push_back(f * mr);
+    for (int v : {256, 512, 1024, 2048, 4096})
+        ncs.push_back((v + nr - 1) / nr * nr);
+
+    GemmConfig best = model_config(detect_caches());
+    gemm_set_config(best);
+    best = gemm_get_config();
+    double best_rate = trial(best, n, opt.trials, A, B, C);
+    if (opt.verbose) {
+        std::cout << "start:   ";
+        print_config(best);
+        std::cout << " -> " << best_rate << " GFLOP/s\n";
+    }
+
+    // Coordinate descent: sweep one parameter at a time holding the rest
+    for (int pass = 0; pass < opt.passes; ++pass) {
+        for (int dim = 0; dim < 4; ++dim) {
+            std::vector<int> values = dim == 0 ? kcs : dim == 1 ? mcs : dim == 2 ? ncs
+                                    : std::vector<int>{LOOP_JR_IR, LOOP_IR_JR};
+            for (int v : values) {
+                GemmConfig cand = best;
+                int &field = dim == 0 ? cand.kc : dim == 1 ? cand.mc : dim == 2 ? cand.nc : cand.loop_order;
+                if (field == v)
+                    continue;
+                field = v;
+                double rate = trial(cand, n, opt.trials, A, B, C);
+                if (rate > best_rate) {
+                    best_rate = rate;
+                    best = cand;
+                    if (opt.verbose) {
+                        std::cout << "better:  ";
+                        print_config(best);
+                        std::cout << " -> " << best_rate << " GFLOP/s\n";
+                    }
+                }
+            }
+        }
+    }
+
+    gemm_set_config(best);
+    if (best_gflops)
+        *best_gflops = best_rate;
+    return best;
+}
+
+// Best-of-trials GFLOP/s of the one-level (three_level false) or three-level
+// tiled nest with the given edges
+static double tile_trial(const TileConfig &tiles, bool three_level, int n, int trials,
+                         const std::vector<float> &A, const std::vector<float> &B, std::vector<float> &C) {
+    const TileOperands<float> ops{A.data(), B.data(), C.data(), n, n, n, n, n, n};
+    double best = 1e30;
+    for (int t = 0; t <= trials; ++t) {     // first run is warm-up
+        std::fill(C.begin(), C.end(), 0.0f);
+        auto start = std::chrono::steady_clock::now();
+        if (three_level)
+            tiled_3level_omp_dispatch(ops, omp_get_max_threads(), false, tiles);
+        else
+            tiled_omp_dispatch(ops, omp_get_max_threads(), false, tiles);
+        double s = seconds_since(start);
+        if (t > 0)
+            best = std::min(best, s);
+    }
+    return 2.0 * n * n * (double)n / best * 1e-9;
+}
+
+static void print_tiles(const TileConfig &tiles) {
+    std::cout << "tile=" << tiles.tile << " l1=" << tiles.l1 << " l2=" << tiles.l2 << " l3=" << tiles.l3;
+}
+
+TileConfig autotune_tiles(const AutotuneOptions &opt) {
+    const int n = opt.size;
+    std::vector<float> A((size_t)n * n, 1.0f), B((size_t)n * n, 0.5f), C((size_t)n * n);
+    const std::vector<int> edges(std::begin(TILE_EDGES), std::end(TILE_EDGES));
+    const std::vector<int> l2s = {64, 128, 256, 512}, l3s = {256, 512, 1024, 2048};
+
+    TileConfig best = default_tile_config();
+    double best_tile = tile_trial(best, false, n, opt.trials, A, B, C);
+    double best_3level = tile_trial(best, true, n, opt.trials, A, B, C);
+    if (opt.verbose) {
+        std::cout << "start:   ";
+        print_tiles(best);
+        std::cout << " -> " << best_tile << " / " << best_3level << " GFLOP/s (one / three levels)\n";
+    }
+
+    for (int e : edges) {
+        TileConfig cand = best;
+        if (cand.tile == e)
+            continue;
+        cand.tile = e;
+        double rate = tile_trial(cand, false, n, opt.trials, A, B, C);
+        if (rate > best_tile) {
+            best_tile = rate;
+            best = cand;
+            if (opt.verbose) {
+                std::cout << "better:  ";
+                print_tiles(best);
+                std::cout << " -> " << best_tile << " GFLOP/s one level\n";
+            }
+        }
+    }
+
+    for (int pass = 0; pass < opt.passes; ++pass) {
+        for (int dim = 0; dim < 3; ++dim) {
+            for (int v : dim == 0 ? edges : dim == 1 ? l2s : l3s) {
+                TileConfig cand = best;
+                int &field = dim == 0 ? cand.l1 : dim == 1 ? cand.l2 : cand.l3;
+                if (field == v)
+                    continue;
+                field = v;
+                if (!tile_config_valid(cand))
+                    continue;
+                double rate = tile_trial(cand, true, n, opt.trials, A, B, C);
+                if (rate > best_3level) {
+                    best_3level = rate;
+                    best = cand;
+                    if (opt.verbose) {
+                        std::cout << "better:  ";
+                        print_tiles(best);
+                        std::cout << " -> " << best_3level << " GFLOP/s three levels\n";
+                    }
+                }
+            }
+        }
+    }
+    return best;
+}
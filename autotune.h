@@ -0,0 +1,96 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <string>
+#include "gemm.h"
+#include "tiled_kernels.h"
+
+// Per-machine blocking for the packed engine. Cache geometry comes from sysfs
+// (cpuid leaf 4 as a fallback), a short timed search picks the tile sizes and
+// loop order, and the winners are stored in a plain-text file keyed by CPU
+// model so a mixed fleet can share one file:
+//
+//     [Intel(R) Core(TM) i7-1165G7 @ 2.80GHz]
+//     kc = 256
+//     mc = 144
+//     nc = 2048
+//     loop_order = jr_ir
+//     fork_join_us = 1.8
+//     core_gflops = 105
+//     socket_gflops = 1480
+//     core_gbs = 14.2
+//     socket_gbs = 38.5
+//     tile = 64
+//     tile_l1 = 64
+//     tile_l2 = 256
+//     tile_l3 = 1024
+//
+// fork_join_us .. socket_gbs are sgemm's cost model (GemmCostModel), written
+// by calibrate_cost_model. The tile keys are the edges of the cache-tiled
+// loop nests (TileConfig, tiled_kernels.h) that tiled_mm_3tiles,
+// tiled_mm_omp, tiled_mm_vect and matmul load at startup. Each save keeps
+// the other keys of the section.
+
+// Data cache sizes in bytes, 0 when unknown
+struct CacheInfo {
+    long l1d = 0;
+    long l2 = 0;
+    long l3 = 0;
+    int line = 64;
+};
+
+CacheInfo detect_caches();
+std::string cpu_model();
+
+// Compiled-in TILE_L1/L2/L3 blocking (gemm.cpp)
+GemmConfig gemm_fallback_config();
+
+// Analytical blocking: a KC x NR micro-panel of B fills half of L1, an MC x KC
+// block of A half of L2 and a KC x NC panel of B half of L3
+GemmConfig model_config(const CacheInfo &caches);
+
+// $GEMM_TUNE_FILE, else $HOME/.gemm_tune.conf
+std::string tune_file_path();
+
+// Entry for cpu_model() in tune_file_path(); false when the CPU was never tuned
+bool load_tuned_config(GemmConfig &cfg);
+
+bool load_config(const std::string &path, const std::string &model, GemmConfig &cfg);
+bool save_config(const std::string &path, const std::string &model, const GemmConfig &cfg);
+
+// Same for the cost model; false when the CPU was never calibrated
+bool load_tuned_cost_model(GemmCostModel &cost);
+bool load_cost_model(const std::string &path, const std::string &model, GemmCostModel &cost);
+bool save_cost_model(const std::string &path, const std::string &model, const GemmCostModel &cost);
+
+// Measures fork/join cost on the full OpenMP team, one-thread and full-team
+// sgemm throughput and read bandwidth (a 128 MB sum), and leaves the result
+// active via gemm_set_cost_model. A second or two.
+GemmCostModel calibrate_cost_model(bool verbose = true);
+
+// Same for the tile edges; false when the CPU was never tuned or the entry is
+// not a valid TileConfig
+bool load_tuned_tiles(TileConfig &tiles);
+bool load_tiles(const std::string &path, const std::string &model, TileConfig &tiles);
+bool save_tiles(const std::string &path, const std::string &model, const TileConfig &tiles);
+
+// The tuned tile edges, else default_tile_config()
+TileConfig tuned_tile_config();
+
+struct AutotuneOptions {
+    int size = 1024;    // square trial problem
+    int trials = 3;     // timed runs per candidate, best one counts
+    int passes = 2;     // coordinate-descent sweeps over kc, mc, nc, loop order
+    bool verbose = true;
+};
+
+// Searches the blocking space starting from model_config() and returns the
+// fastest config found; leaves it active via gemm_set_config
+GemmConfig autotune(const AutotuneOptions &opt, double *best_gflops = nullptr);
+
+// Same coordinate descent over the tile edges: tile over TILE_EDGES timing
+// tiled_omp_dispatch, then l1 (TILE_EDGES), l2 and l3 (multiples that nest)
+// timing tiled_3level_omp_dispatch, on the full OpenMP team
+TileConfig autotune_tiles(const AutotuneOptions &opt);
+
+#endif
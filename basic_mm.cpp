@@ -1,60 +1,59 @@
 #include <iostream>
 #include <vector>
 #include <thread>
-#include <random>
+#include <algorithm>
+#include "perf_counters.h"
+#include "team_plan.h"
+#include "tiled_kernels.h"
+#include "matrix.h"
+#include "rng.h"
 
 #define N 2048        
 #define BLOCK_SIZE 64 
-#define NUM_THREADS 4
 
-void initializeMatrix(std::vector<int>& mat, int n) {
-	std::random_device rd;
-	std::mt19937 gen(rd());
-	std::uniform_int_distribution<int> dist(0, 9);
-
-	for (int i = 0; i < n * n; ++i) {
-		mat[i] = dist(gen);
-	}
+// Integers 0-9 from a counter-based stream: the same matrix on every run
+void initializeMatrix(DenseMatrix<int>& mat, uint64_t seed) {
+	philox_fill_int(mat, seed, 0, 9);
 }
 
-void multiplyMatrices(const std::vector<int>& A, const std::vector<int>& B, std::vector<int>& C,
+// Thread t gets an equal share of whole BLOCK_SIZE row blocks, so no thread
+// is left with the remainder and no tile straddles two threads
+void multiplyMatrices(const DenseMatrix<int>& A, const DenseMatrix<int>& B, DenseMatrix<int>& C,
                       int n, int thread_id, int num_threads) {
-	int rows_per_thread = n / num_threads;
-	int row_start = thread_id * rows_per_thread;
-	int row_end = (thread_id == num_threads - 1) ? n : row_start + rows_per_thread;
-
-	for (int ii = row_start; ii < row_end; ii += BLOCK_SIZE) {
-		for (int jj = 0; jj < n; jj += BLOCK_SIZE) {
-			for (int kk = 0; kk < n; kk += BLOCK_SIZE) {
-				for (int i = ii; i < std::min(ii + BLOCK_SIZE, row_end); ++i) {
-					for (int j = jj; j < std::min(jj + BLOCK_SIZE, n); ++j) {
-						int sum = 0;
-						for (int k = kk; k < std::min(kk + BLOCK_SIZE, n); ++k) {
-							sum += A[i * n + k] * B[k * n + j];
-						}
-						C[i * n + j] += sum;
-					}
-				}
-			}
-		}
-	}
+	int blocks = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	int row_start = std::min(n, blocks * thread_id / num_threads * BLOCK_SIZE);
+	int row_end = std::min(n, blocks * (thread_id + 1) / num_threads * BLOCK_SIZE);
+
+	TileOperands<int> ops{A.data(), B.data(), C.data(), n, n, n, A.ld(), B.ld(), C.ld()};
+	tiled_rows<int, BLOCK_SIZE>(ops, row_start, row_end);
 }
 
 int main() {
-	std::vector<int> A(N * N), B(N * N), C(N * N, 0);
-	initializeMatrix(A, N);
-	initializeMatrix(B, N);
-
-	std::cout << "Running with " << NUM_THREADS << " threads...\n";
-
+	DenseMatrix<int> A(N, N), B(N, N), C(N, N, 0);
+	initializeMatrix(A, 1);
+	initializeMatrix(B, 2);
+
+	// Team size from this kernel's own speed: one BLOCK_SIZE tile over all of k,
+	// timed on scratch operands, times the tiles in a row block
+	DenseMatrix<int> a(BLOCK_SIZE, N, 1), b(N, BLOCK_SIZE, 1), c(BLOCK_SIZE, BLOCK_SIZE, 0);
+	TileOperands<int> scratch{a.data(), b.data(), c.data(), BLOCK_SIZE, BLOCK_SIZE, N, a.ld(), b.ld(), c.ld()};
+	const int blocks = (N + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const double block_s = blocks * time_best([&] { tiled_rows<int, BLOCK_SIZE>(scratch, 0, BLOCK_SIZE); });
+	const int num_threads = plan_team(blocks, block_s, std::max(1u, std::thread::hardware_concurrency())).num_threads;
+	std::cout << "Running with " << num_threads << " threads...\n";
+
+	PerfCounters counters;
+	counters.start();
 	std::vector<std::thread> threads;
-	for (int t = 0; t < NUM_THREADS; ++t) {
-		threads.emplace_back(multiplyMatrices, std::cref(A), std::cref(B), std::ref(C), N, t, NUM_THREADS);
+	for (int t = 0; t < num_threads; ++t) {
+		threads.emplace_back(multiplyMatrices, std::cref(A), std::cref(B), std::ref(C), N, t, num_threads);
 	}
 	for (auto& t : threads) {
 		t.join();
 	}
+	counters.stop();
 
 	std::cout << "Matrix multiplication completed.\n";
+	counters.report(std::cout, 2.0 * N * N * N);
 	return 0;
 }
@@ -0,0 +1,400 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <omp.h>
+#include "kernels.h"
+#include "perf_counters.h"
+#include "roofline.h"
+#include "autotune.h"
+#include "thread_pool.h"
+#include "matrix.h"
+#include "rng.h"
+
+// Unified benchmark driver: every registered kernel runs on the same inputs,
+// with the same timer, over a sweep of sizes and thread counts.
+//
+// --roofline measures the machine's ceilings once per thread count (FMA peak,
+// triad bandwidth of L1, L2, L3 and DRAM) and places every result on the
+// roofline: arithmetic intensity from the LLC misses of the counter run when
+// they are available, else from the kernel's blocking model, the attainable
+// GFLOP/s at that intensity, the fraction of it reached, and whether the
+// kernel sits left (memory-bound) or right (compute-bound) of the ridge.
+//
+// Usage: ./bench [--kernels a,b,...] [--sizes 256,512,...] [--threads 1,2,...]
+//                [--warmup W] [--reps R] [--format csv|json] [--out FILE]
+//                [--no-check] [--counters] [--roofline] [--list]
+
+struct Options {
+    std::vector<std::string> kernels;
+    std::vector<int> sizes = {256, 512, 1024};
+    std::vector<int> threads;
+    int warmup = 1;
+    int reps = 5;
+    std::string format = "csv";
+    std::string out;
+    bool check = true;
+    bool counters = false;
+    bool roofline = false;  // implies counters
+};
+
+struct Result {
+    const Kernel *kernel;
+    int n;
+    int threads;
+    int reps;
+    double median_s;
+    double p95_s;
+    double min_s;
+    double gflops;
+    double max_err;     // NaN when not checked
+    PerfSample counters;  // one extra run, when --counters is given
+    RooflineCeilings roof;  // when --roofline is given
+};
+
+static std::vector<std::string> split(const std::string &s) {
+    std::vector<std::string> parts;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ','))
+        if (!item.empty())
+            parts.push_back(item);
+    return parts;
+}
+
+static std::vector<int> split_ints(const std::string &s) {
+    std::vector<int> values;
+    for (const std::string &item : split(s))
+        values.push_back(std::atoi(item.c_str()));
+    return values;
+}
+
+static bool all_positive(const std::vector<int> &values) {
+    return std::all_of(values.begin(), values.end(), [](int v) { return v >= 1; });
+}
+
+static void usage() {
+    std::cerr << "Usage: ./bench [--kernels a,b,...] [--sizes 256,512,...] [--threads 1,2,...]\n"
+                 "               [--warmup W] [--reps R] [--format csv|json] [--out FILE]\n"
+                 "               [--no-check] [--counters] [--roofline] [--list]\n";
+}
+
+static bool parse_args(int argc, char **argv, Options &opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--list") {
+            for (const Kernel &k : kernel_registry())
+                std::cout << k.name << "\t" << k.source << (k.parallel ? "" : "\t(serial)") << "\n";
+            std::exit(0);
+        } else if (arg == "--no-check") {
+            opt.check = false;
+        } else if (arg == "--counters") {
+            opt.counters = true;
+        } else if (arg == "--roofline") {
+            opt.roofline = opt.counters = true;
+        } else if (arg == "--kernels" && has_value) {
+            opt.kernels = split(argv[++i]);
+        } else if (arg == "--sizes" && has_value) {
+            opt.sizes = split_ints(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            opt.threads = split_ints(argv[++i]);
+        } else if (arg == "--warmup" && has_value) {
+            opt.warmup = std::atoi(argv[++i]);
+        } else if (arg == "--reps" && has_value) {
+            opt.reps = std::atoi(argv[++i]);
+        } else if (arg == "--format" && has_value) {
+            opt.format = argv[++i];
+        } else if (arg == "--out" && has_value) {
+            opt.out = argv[++i];
+        } else {
+            usage();
+            return false;
+        }
+    }
+    if (opt.threads.empty()) {
+        opt.threads.push_back(1);
+        if (omp_get_max_threads() > 1)
+            opt.threads.push_back(omp_get_max_threads());
+    }
+    // A size or thread count below 1 (or not a number) would crash a kernel
+    if (opt.reps < 1 || opt.warmup < 0 || !all_positive(opt.sizes) || !all_positive(opt.threads) ||
+        (opt.format != "csv" && opt.format != "json")) {
+        usage();
+        return false;
+    }
+    return true;
+}
+
+// Same fixed-seed inputs for every kernel so runs are comparable
+static void initialize_matrix(DenseMatrix<float> &mat, unsigned seed) {
+    philox_fill_uniform(mat, seed, 0.0f, 1.0f);
+}
+
+// Max abs error over a handful of rows, recomputed in double
+static double sampled_error(const DenseMatrix<float> &A, const DenseMatrix<float> &B,
+                            const DenseMatrix<float> &C, int n) {
+    double max_err = 0.0;
+    int step = std::max(1, n / 8);
+    std::vector<double> row(n);
+    for (int i = 0; i < n; i += step) {
+        std::fill(row.begin(), row.end(), 0.0);
+        for (int k = 0; k < n; ++k) {
+            double a = A(i, k);
+            for (int j = 0; j < n; ++j)
+                row[j] += a * B(k, j);
+        }
+        for (int j = 0; j < n; ++j)
+            max_err = std::max(max_err, std::fabs(row[j] - C(i, j)));
+    }
+    return max_err;
+}
+
+// Nearest-rank percentile of an already sorted sample
+static double percentile(const std::vector<double> &sorted, double p) {
+    size_t rank = (size_t)std::ceil(p / 100.0 * sorted.size());
+    return sorted[std::min(sorted.size() - 1, rank == 0 ? 0 : rank - 1)];
+}
+
+static Result run_one(const Kernel &kernel, int n, int threads, const Options &opt,
+                      const DenseMatrix<float> &A, const DenseMatrix<float> &B, DenseMatrix<float> &C) {
+    std::vector<double> times;
+    for (int r = 0; r < opt.warmup + opt.reps; ++r) {
+        C.fill(0.0f);
+        auto start = std::chrono::steady_clock::now();
+        kernel.fn(A.data(), B.data(), C.data(), n, threads);
+        auto end = std::chrono::steady_clock::now();
+        if (r >= opt.warmup)
+            times.push_back(std::chrono::duration<double>(end - start).count());
+    }
+    std::sort(times.begin(), times.end());
+
+    Result res;
+    res.kernel = &kernel;
+    res.n = n;
+    res.threads = threads;
+    res.reps = opt.reps;
+    res.median_s = times.size() % 2 ? times[times.size() / 2]
+                                    : 0.5 * (times[times.size() / 2 - 1] + times[times.size() / 2]);
+    res.p95_s = percentile(times, 95.0);
+    res.min_s = times.front();
+    res.gflops = 2.0 * n * n * (double)n / res.median_s * 1e-9;
+    res.max_err = opt.check ? sampled_error(A, B, C, n) : NAN;
+
+    if (opt.counters) {
+        PerfCounters counters;
+        C.fill(0.0f);
+        counters.start(threads);
+        if (kernel.pooled)
+            kernel_pool(threads).run_on_each_thread([&](int) { counters.attach_current_thread(); });
+        kernel.fn(A.data(), B.data(), C.data(), n, threads);
+        counters.stop();
+        res.counters = counters.total();
+    }
+    return res;
+}
+
+// Counter-derived metrics, NaN when the event was not available
+static double ipc(const Result &r) {
+    double v = r.counters.ratio(EV_INSTRUCTIONS, EV_CYCLES);
+    return v < 0 ? NAN : v;
+}
+
+static double per_flop(const Result &r, PerfEvent e) {
+    return r.counters.valid[e] ? r.counters.value[e] / (2.0 * r.n * r.n * (double)r.n) : NAN;
+}
+
+static const PerfEvent miss_events[] = {EV_L1D_MISSES, EV_LLC_MISSES, EV_DTLB_MISSES};
+
+// FLOP per byte of memory traffic: modelled from the kernel's blocking, or
+// measured as LLC misses times the line size
+static double ai_model(const Result &r) {
+    return r.kernel->traffic ? 2.0 * r.n * r.n * (double)r.n / r.kernel->traffic(r.n) : NAN;
+}
+
+static double ai_counters(const Result &r) {
+    if (!r.counters.valid[EV_LLC_MISSES] || r.counters.value[EV_LLC_MISSES] == 0)
+        return NAN;
+    return 2.0 * r.n * r.n * (double)r.n / (r.counters.value[EV_LLC_MISSES] * (double)detect_caches().line);
+}
+
+static double intensity(const Result &r) {
+    double ai = ai_counters(r);
+    return std::isnan(ai) ? ai_model(r) : ai;
+}
+
+static double roof_gflops(const Result &r) {
+    double ai = intensity(r);
+    return std::isnan(ai) ? NAN : r.roof.attainable(ai);
+}
+
+static const char *bound(const Result &r) {
+    double ai = intensity(r);
+    if (std::isnan(ai))
+        return "";
+    return ai < r.roof.ridge() ? "memory" : "compute";
+}
+
+static const char *const roofline_columns[] = {"peak_gflops", "l1_gbs", "l2_gbs", "l3_gbs", "dram_gbs",
+                                               "ai_model", "ai_counters", "roof_gflops", "roof_fraction"};
+
+// Values in roofline_columns order; a level the probe could not isolate is NaN
+static std::vector<double> roofline_values(const Result &r) {
+    std::vector<double> v = {r.roof.peak_gflops};
+    for (int level = 0; level < ROOF_LEVELS; ++level)
+        v.push_back(r.roof.gbs[level] > 0.0 ? r.roof.gbs[level] : NAN);
+    v.push_back(ai_model(r));
+    v.push_back(ai_counters(r));
+    v.push_back(roof_gflops(r));
+    v.push_back(r.gflops / roof_gflops(r));
+    return v;
+}
+
+static void write_csv(std::ostream &os, const std::vector<Result> &results, bool counters, bool roofline) {
+    os << "kernel,source,n,threads,reps,median_s,p95_s,min_s,gflops,max_err";
+    if (counters) {
+        os << ",ipc";
+        for (PerfEvent e : miss_events)
+            os << "," << perf_event_names[e] << "_per_flop";
+    }
+    if (roofline) {
+        for (const char *column : roofline_columns)
+            os << "," << column;
+        os << ",bound";
+    }
+    os << "\n";
+    auto value = [&](double v) {
+        os << ",";
+        if (!std::isnan(v))
+            os << v;
+    };
+    for (const Result &r : results) {
+        os << r.kernel->name << "," << r.kernel->source << "," << r.n << "," << r.threads << ","
+           << r.reps << "," << r.median_s << "," << r.p95_s << "," << r.min_s << "," << r.gflops;
+        value(r.max_err);
+        if (counters) {
+            value(ipc(r));
+            for (PerfEvent e : miss_events)
+                value(per_flop(r, e));
+        }
+        if (roofline) {
+            for (double v : roofline_values(r))
+                value(v);
+            os << "," << bound(r);
+        }
+        os << "\n";
+    }
+}
+
+static void write_json(std::ostream &os, const std::vector<Result> &results, bool counters, bool roofline) {
+    auto value = [&](const char *key, double v) {
+        os << ", \"" << key << "\": ";
+        if (std::isnan(v))
+            os << "null";
+        else
+            os << v;
+    };
+    os << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &r = results[i];
+        os << "  {\"kernel\": \"" << r.kernel->name << "\", \"source\": \"" << r.kernel->source
+           << "\", \"n\": " << r.n << ", \"threads\": " << r.threads << ", \"reps\": " << r.reps
+           << ", \"median_s\": " << r.median_s << ", \"p95_s\": " << r.p95_s
+           << ", \"min_s\": " << r.min_s << ", \"gflops\": " << r.gflops;
+        value("max_err", r.max_err);
+        if (counters) {
+            value("ipc", ipc(r));
+            for (PerfEvent e : miss_events)
+                value((std::string(perf_event_names[e]) + "_per_flop").c_str(), per_flop(r, e));
+        }
+        if (roofline) {
+            std::vector<double> v = roofline_values(r);
+            for (size_t c = 0; c < v.size(); ++c)
+                value(roofline_columns[c], v[c]);
+            os << ", \"bound\": \"" << bound(r) << "\"";
+        }
+        os << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "]\n";
+}
+
+int main(int argc, char **argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt))
+        return -1;
+
+    std::vector<const Kernel *> selected;
+    if (opt.kernels.empty()) {
+        for (const Kernel &k : kernel_registry())
+            selected.push_back(&k);
+    } else {
+        for (const std::string &name : opt.kernels) {
+            const Kernel *k = find_kernel(name.c_str());
+            if (!k) {
+                std::cerr << "Unknown kernel: " << name << " (see --list)" << std::endl;
+                return -1;
+            }
+            selected.push_back(k);
+        }
+    }
+
+    // Ceilings once per team size, before any kernel has warmed anything
+    std::map<int, RooflineCeilings> roofs;
+    if (opt.roofline) {
+        const CacheInfo caches = detect_caches();
+        for (const Kernel *k : selected)
+            for (int threads : k->parallel ? opt.threads : std::vector<int>{1}) {
+                if (roofs.count(threads))
+                    continue;
+                const RooflineCeilings &roof = roofs[threads] = measure_ceilings(threads, caches);
+                std::cerr << "roofline threads=" << threads << ": peak " << roof.peak_gflops << " GFLOP/s";
+                for (int level = 0; level < ROOF_LEVELS; ++level)
+                    if (roof.gbs[level] > 0.0)
+                        std::cerr << ", " << roofline_level_names[level] << " " << roof.gbs[level] << " GB/s";
+                std::cerr << ", ridge " << roof.ridge() << " FLOP/byte\n";
+            }
+    }
+
+    std::vector<Result> results;
+    for (int n : opt.sizes) {
+        // Unpadded: KernelFn takes a row stride of n
+        DenseMatrix<float> A(n, n, false), B(n, n, false), C(n, n, false);
+        initialize_matrix(A, 1);
+        initialize_matrix(B, 2);
+
+        for (const Kernel *k : selected) {
+            std::vector<int> sweep = k->parallel ? opt.threads : std::vector<int>{1};
+            for (int threads : sweep) {
+                Result r = run_one(*k, n, threads, opt, A, B, C);
+                if (opt.roofline)
+                    r.roof = roofs[threads];
+                std::cerr << k->name << " n=" << n << " threads=" << threads
+                          << ": median " << r.median_s << " s, " << r.gflops << " GFLOP/s\n";
+                results.push_back(r);
+            }
+        }
+    }
+
+    std::ofstream file;
+    if (!opt.out.empty()) {
+        file.open(opt.out);
+        if (!file) {
+            std::cerr << "Cannot open " << opt.out << std::endl;
+            return -1;
+        }
+    }
+    std::ostream &os = opt.out.empty() ? std::cout : file;
+    if (opt.format == "json")
+        write_json(os, results, opt.counters, opt.roofline);
+    else
+        write_csv(os, results, opt.counters, opt.roofline);
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+// Runtime ISA dispatch for kernels built in several target versions inside
+// one binary. Compile the program for the oldest node it must run on (plain
+// -O3 -fopenmp is x86-64/SSE2), not -march=native; wrappers marked
+// ISA_TARGET_AVX2 / ISA_TARGET_AVX512 get their whole call tree inlined and
+// compiled for that ISA, and selected_isa() picks one at startup:
+//
+//     switch (selected_isa()) {
+//     case ISA_AVX512: return kernel_avx512(...);
+//     case ISA_AVX2:   return kernel_avx2(...);
+//     default:         return kernel_base(...);
+//     }
+//
+// The choice is the widest ISA cpuid reports (with OS support for the wider
+// registers), unless GEMM_ISA forces one for benchmarking:
+//
+//     GEMM_ISA=avx512 | avx2 | sse2
+//
+// Forcing an ISA the CPU lacks falls back to the detected one with a warning.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+enum CpuIsa {
+    ISA_SSE2 = 0,       // the build's baseline target
+    ISA_AVX2 = 1,       // AVX2 + FMA, 256-bit vectors
+    ISA_AVX512 = 2      // AVX-512 F/VL/BW/DQ, 512-bit vectors
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ISA_TARGET_AVX512 \
+    __attribute__((target("avx512f,avx512vl,avx512bw,avx512dq,avx2,fma,prefer-vector-width=512"), flatten))
+#define ISA_TARGET_AVX2 __attribute__((target("avx2,fma"), flatten))
+#else
+#define ISA_TARGET_AVX512 __attribute__((flatten))
+#define ISA_TARGET_AVX2 __attribute__((flatten))
+#endif
+#define ISA_TARGET_BASE __attribute__((flatten))
+
+inline const char *isa_name(CpuIsa isa) {
+    switch (isa) {
+    case ISA_AVX512: return "avx512";
+    case ISA_AVX2: return "avx2";
+    default: return "sse2";
+    }
+}
+
+inline CpuIsa detect_isa() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") &&
+        __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512dq"))
+        return ISA_AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return ISA_AVX2;
+#endif
+    return ISA_SSE2;
+}
+
+// Detected once; GEMM_ISA can only narrow the choice
+inline CpuIsa selected_isa() {
+    static const CpuIsa isa = [] {
+        CpuIsa detected = detect_isa();
+        const char *env = std::getenv("GEMM_ISA");
+        if (!env || !*env)
+            return detected;
+        CpuIsa forced = detected;
+        if (std::strcmp(env, "avx512") == 0)
+            forced = ISA_AVX512;
+        else if (std::strcmp(env, "avx2") == 0)
+            forced = ISA_AVX2;
+        else if (std::strcmp(env, "sse2") == 0)
+            forced = ISA_SSE2;
+        else
+            std::fprintf(stderr, "GEMM_ISA=%s not recognized, using %s\n", env, isa_name(detected));
+        if (forced > detected) {
+            std::fprintf(stderr, "GEMM_ISA=%s not supported by this CPU, using %s\n", env, isa_name(detected));
+            forced = detected;
+        }
+        return forced;
+    }();
+    return isa;
+}
+
+#endif
@@ -0,0 +1,997 @@
+#include "gemm.h"
+#include "autotune.h"
+
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <omp.h>
+#include <immintrin.h>
+
+// The TILE_L1/L2/L3 hierarchy sizes packed buffers instead of loop bounds.
+// These are only the fallback when neither a tuned config nor the cache
+// geometry is available; see GemmConfig.
+const int TILE_L1 = 256;    // KC: depth of a micro-panel, MR x KC of A + KC x NR of B stay in L1
+const int TILE_L2 = 144;    // MC: rows of A packed per block, MC x KC stays in L2
+const int TILE_L3 = 2048;   // NC: columns of B packed per panel, KC x NC stays in L3
+
+// Register block of C held by the microkernel
+#if defined(__AVX512F__)
+const int MR = 12;          // 12 x 2 zmm accumulators
+const int NR = 32;
+#elif defined(__AVX2__) && defined(__FMA__)
+const int MR = 6;           // 6 x 2 ymm accumulators
+const int NR = 16;
+#else
+const int MR = 4;
+const int NR = 8;
+#endif
+
+static float *aligned_buffer(size_t count) {
+    size_t bytes = (count * sizeof(float) + 63) / 64 * 64;
+    return static_cast<float *>(std::aligned_alloc(64, bytes));
+}
+
+// Element widening for the packing routines. bf16 is the top half of an
+// fp32; fp16 needs a rebias, done by F16C when it is compiled in.
+static inline float to_float(float x) { return x; }
+
+static inline float to_float(bf16_t x) {
+    uint32_t bits = (uint32_t)x.bits << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static inline float to_float(fp16_t x) {
+#if defined(__F16C__)
+    return _cvtsh_ss(x.bits);
+#else
+    uint32_t sign = (uint32_t)(x.bits & 0x8000) << 16;
+    uint32_t exp = (x.bits >> 10) & 0x1f;
+    uint32_t mant = x.bits & 0x3ff;
+    uint32_t bits;
+    if (exp == 0x1f) {
+        bits = sign | 0x7f800000 | mant << 13;              // inf / NaN, quieted like F16C
+        if (mant != 0)
+            bits |= 0x400000;
+    } else if (exp != 0) {
+        bits = sign | (exp + 112) << 23 | mant << 13;       // normal
+    } else if (mant == 0) {
+        bits = sign;                                        // +-0
+    } else {
+        int shift = 0;                                      // subnormal: renormalize
+        while (!(mant & 0x400)) {
+            mant <<= 1;
+            ++shift;
+        }
+        bits = sign | (uint32_t)(113 - shift) << 23 | (mant & 0x3ff) << 13;
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+#endif
+}
+
+static inline bf16_t to_bf16(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    if ((bits & 0x7fffffff) > 0x7f800000)
+        return bf16_t{(uint16_t)(bits >> 16 | 0x40)};      // keep NaNs quiet
+    bits += 0x7fff + ((bits >> 16) & 1);
+    return bf16_t{(uint16_t)(bits >> 16)};
+}
+
+static inline fp16_t to_f16(float f) {
+#if defined(__F16C__)
+    return fp16_t{(uint16_t)_cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT)};
+#else
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    uint32_t abs = bits & 0x7fffffff;
+    if (abs > 0x7f800000)
+        return fp16_t{(uint16_t)(sign | 0x7e00)};
+    if (abs >= 0x477ff000)                                  // rounds past 65504
+        return fp16_t{(uint16_t)(sign | 0x7c00)};
+    if (abs >= 0x38800000) {                                // normal
+        uint32_t h = abs - (112u << 23);
+        h += 0xfff + ((h >> 13) & 1);
+        return fp16_t{(uint16_t)(sign | h >> 13)};
+    }
+    if (abs <= 0x33000000)                                  // below half the smallest subnormal
+        return fp16_t{(uint16_t)sign};
+    uint32_t shift = 126 - (abs >> 23);
+    uint32_t mant = (abs & 0x7fffff) | 0x800000;
+    uint32_t h = mant >> shift;
+    uint32_t rem = mant & ((1u << shift) - 1), half = 1u << (shift - 1);
+    if (rem > half || (rem == half && (h & 1)))
+        ++h;
+    return fp16_t{(uint16_t)(sign | h)};
+#endif
+}
+
+// Contiguous run of n elements into fp32
+template <typename T>
+static inline void widen(const T *src, float *dst, int n) {
+    for (int i = 0; i < n; ++i)
+        dst[i] = to_float(src[i]);
+}
+
+#if defined(__F16C__)
+static inline void widen(const fp16_t *src, float *dst, int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + i))));
+    for (; i < n; ++i)
+        dst[i] = to_float(src[i]);
+}
+#endif
+
+// Copies an mc x kc block of op(A) into MR-row micro-panels, column by column.
+// Rows past the edge are zero-filled so the microkernel never branches.
+template <typename T>
+static void pack_A(const T *A, int lda, bool trans, int i0, int k0, int mc, int kc, float *buf) {
+    for (int ir = 0; ir < mc; ir += MR) {
+        int mr = std::min(MR, mc - ir);
+        for (int p = 0; p < kc; ++p) {
+            if (trans) {
+                widen(A + (size_t)(k0 + p) * lda + i0 + ir, buf, mr);
+            } else {
+                const T *src = A + (size_t)(i0 + ir) * lda + k0 + p;
+                for (int r = 0; r < mr; ++r)
+                    buf[r] = to_float(src[(size_t)r * lda]);
+            }
+            for (int r = mr; r < MR; ++r)
+                buf[r] = 0.0f;
+            buf += MR;
+        }
+    }
+}
+
+// Copies a kc x nc panel of op(B) into NR-column micro-panels, row by row.
+// Called by the whole team; the implicit barrier publishes the panel.
+template <typename T>
+static void pack_B(const T *B, int ldb, bool trans, int k0, int j0, int kc, int nc, float *buf) {
+    #pragma omp for schedule(static)
+    for (int jr = 0; jr < nc; jr += NR) {
+        int nr = std::min(NR, nc - jr);
+        float *dst = buf + (size_t)jr * kc;
+        for (int p = 0; p < kc; ++p) {
+            if (trans) {
+                const T *src = B + (size_t)(j0 + jr) * ldb + k0 + p;
+                for (int c = 0; c < nr; ++c)
+                    dst[c] = to_float(src[(size_t)c * ldb]);
+            } else {
+                widen(B + (size_t)(k0 + p) * ldb + j0 + jr, dst, nr);
+            }
+            for (int c = nr; c < NR; ++c)
+                dst[c] = 0.0f;
+            dst += NR;
+        }
+    }
+}
+
+// C[MR x NR] = alpha * A_panel * B_panel + beta * C, with the whole C block
+// kept in registers. beta == 0 never reads C.
+static inline void micro_kernel(int kc, const float *a, const float *b, float *c, int ldc,
+                                float alpha, float beta) {
+#if defined(__AVX512F__)
+    __m512 acc[MR][2];
+    #pragma GCC unroll 12
+    for (int r = 0; r < MR; ++r)
+        acc[r][0] = acc[r][1] = _mm512_setzero_ps();
+
+    for (int p = 0; p < kc; ++p) {
+        __m512 b0 = _mm512_load_ps(b);
+        __m512 b1 = _mm512_load_ps(b + 16);
+        #pragma GCC unroll 12
+        for (int r = 0; r < MR; ++r) {
+            __m512 ar = _mm512_set1_ps(a[r]);
+            acc[r][0] = _mm512_fmadd_ps(ar, b0, acc[r][0]);
+            acc[r][1] = _mm512_fmadd_ps(ar, b1, acc[r][1]);
+        }
+        a += MR;
+        b += NR;
+    }
+
+    __m512 va = _mm512_set1_ps(alpha);
+    __m512 vb = _mm512_set1_ps(beta);
+    #pragma GCC unroll 12
+    for (int r = 0; r < MR; ++r) {
+        float *cr = c + (size_t)r * ldc;
+        __m512 c0 = _mm512_mul_ps(va, acc[r][0]);
+        __m512 c1 = _mm512_mul_ps(va, acc[r][1]);
+        if (beta != 0.0f) {
+            c0 = _mm512_fmadd_ps(vb, _mm512_loadu_ps(cr), c0);
+            c1 = _mm512_fmadd_ps(vb, _mm512_loadu_ps(cr + 16), c1);
+        }
+        _mm512_storeu_ps(cr, c0);
+        _mm512_storeu_ps(cr + 16, c1);
+    }
+#elif defined(__AVX2__) && defined(__FMA__)
+    __m256 acc[MR][2];
+    #pragma GCC unroll 6
+    for (int r = 0; r < MR; ++r)
+        acc[r][0] = acc[r][1] = _mm256_setzero_ps();
+
+    for (int p = 0; p < kc; ++p) {
+        __m256 b0 = _mm256_load_ps(b);
+        __m256 b1 = _mm256_load_ps(b + 8);
+        #pragma GCC unroll 6
+        for (int r = 0; r < MR; ++r) {
+            __m256 ar = _mm256_broadcast_ss(a + r);
+            acc[r][0] = _mm256_fmadd_ps(ar, b0, acc[r][0]);
+            acc[r][1] = _mm256_fmadd_ps(ar, b1, acc[r][1]);
+        }
+        a += MR;
+        b += NR;
+    }
+
+    __m256 va = _mm256_set1_ps(alpha);
+    __m256 vb = _mm256_set1_ps(beta);
+    #pragma GCC unroll 6
+    for (int r = 0; r < MR; ++r) {
+        float *cr = c + (size_t)r * ldc;
+        __m256 c0 = _mm256_mul_ps(va, acc[r][0]);
+        __m256 c1 = _mm256_mul_ps(va, acc[r][1]);
+        if (beta != 0.0f) {
+            c0 = _mm256_fmadd_ps(vb, _mm256_loadu_ps(cr), c0);
+            c1 = _mm256_fmadd_ps(vb, _mm256_loadu_ps(cr + 8), c1);
+        }
+        _mm256_storeu_ps(cr, c0);
+        _mm256_storeu_ps(cr + 8, c1);
+    }
+#else
+    float acc[MR][NR] = {};
+    for (int p = 0; p < kc; ++p) {
+        for (int r = 0; r < MR; ++r) {
+            #pragma omp simd
+            for (int j = 0; j < NR; ++j)
+                acc[r][j] += a[r] * b[j];
+        }
+        a += MR;
+        b += NR;
+    }
+    for (int r = 0; r < MR; ++r)
+        for (int j = 0; j < NR; ++j) {
+            float *cj = c + (size_t)r * ldc + j;
+            *cj = beta != 0.0f ? alpha * acc[r][j] + beta * *cj : alpha * acc[r][j];
+        }
+#endif
+}
+
+// Edge blocks run the full kernel into a scratch tile and copy back the valid part
+static void micro_kernel_edge(int kc, const float *a, const float *b, float *c, int ldc,
+                              int mr, int nr, float alpha, float beta) {
+    alignas(64) float tmp[MR * NR];
+    micro_kernel(kc, a, b, tmp, NR, 1.0f, 0.0f);
+    for (int r = 0; r < mr; ++r)
+        for (int j = 0; j < nr; ++j) {
+            float *cj = c + (size_t)r * ldc + j;
+            *cj = beta != 0.0f ? alpha * tmp[r * NR + j] + beta * *cj : alpha * tmp[r * NR + j];
+        }
+}
+
+// C = beta * C, used when there is no product to accumulate
+static void scale_C(int m, int n, float beta, float *C, int ldc) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < m; ++i) {
+        float *ci = C + (size_t)i * ldc;
+        for (int j = 0; j < n; ++j)
+            ci[j] = beta != 0.0f ? beta * ci[j] : 0.0f;
+    }
+}
+
+// exp(x) by 2^n * p(r), |r| <= ln2 / 2, with a degree-5 polynomial
+// (relative error ~2e-7); plain arithmetic, so it vectorizes under omp simd
+#pragma omp declare simd
+static inline float exp_approx(float x) {
+    x = std::min(std::max(x, -87.0f), 88.0f);
+    float n = std::floor(x * 1.44269504f + 0.5f);
+    float r = x - n * 0.693145752f - n * 1.42860677e-6f;
+    float p = 1.0f + r * (1.0f + r * (0.5f + r * (0.166666672f + r * (0.0416664779f + r * 0.00833345205f))));
+    int32_t bits = ((int32_t)n + 127) << 23;
+    float scale;
+    std::memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+// tanh-approximation GELU: 0.5 x (1 + tanh(z)) = x * sigmoid(2z)
+#pragma omp declare simd
+static inline float gelu(float x) {
+    const float z2 = 1.59576912f * (x + 0.044715f * x * x * x);
+    return x / (1.0f + exp_approx(-z2));
+}
+
+// Bias and activation over an mr x nr tile of C whose top-left element is
+// (i0, j0) of the full matrix
+static void apply_epilogue(float *c, int ldc, int mr, int nr, int i0, int j0, const GemmEpilogue &ep) {
+    for (int r = 0; r < mr; ++r) {
+        float *cr = c + (size_t)r * ldc;
+        if (ep.bias_mode == GEMM_BIAS_ROW) {
+            const float b = ep.bias[i0 + r];
+            #pragma omp simd
+            for (int j = 0; j < nr; ++j)
+                cr[j] += b;
+        } else if (ep.bias_mode == GEMM_BIAS_COL) {
+            const float *b = ep.bias + j0;
+            #pragma omp simd
+            for (int j = 0; j < nr; ++j)
+                cr[j] += b[j];
+        }
+        if (ep.activation == GEMM_ACT_RELU) {
+            #pragma omp simd
+            for (int j = 0; j < nr; ++j)
+                cr[j] = std::max(cr[j], 0.0f);
+        } else if (ep.activation == GEMM_ACT_GELU) {
+            #pragma omp simd
+            for (int j = 0; j < nr; ++j)
+                cr[j] = gelu(cr[j]);
+        }
+    }
+}
+
+// The epilogue, when given, runs on the tile the kernel just stored
+static void block_kernel(int kc, const float *a, const float *b, float *c, int ldc,
+                         int mr, int nr, float alpha, float beta,
+                         const GemmEpilogue *ep, int i0, int j0) {
+    if (mr == MR && nr == NR)
+        micro_kernel(kc, a, b, c, ldc, alpha, beta);
+    else
+        micro_kernel_edge(kc, a, b, c, ldc, mr, nr, alpha, beta);
+    if (ep)
+        apply_epilogue(c, ldc, mr, nr, i0, j0, *ep);
+}
+
+// Sweeps a packed mc x kc block of A against a packed kc x nc panel of B.
+// C is element (i0, j0) of the full matrix; ep is only passed for the last k-block.
+static void macro_kernel(int mc, int nc, int kc, const float *packed_A, const float *packed_B,
+                         float *C, int ldc, float alpha, float beta, int loop_order,
+                         const GemmEpilogue *ep, int i0, int j0) {
+    if (loop_order == LOOP_IR_JR) {
+        for (int ir = 0; ir < mc; ir += MR) {
+            int mr = std::min(MR, mc - ir);
+            const float *a = packed_A + (size_t)ir * kc;
+            for (int jr = 0; jr < nc; jr += NR)
+                block_kernel(kc, a, packed_B + (size_t)jr * kc, C + (size_t)ir * ldc + jr, ldc,
+                             mr, std::min(NR, nc - jr), alpha, beta, ep, i0 + ir, j0 + jr);
+        }
+    } else {
+        for (int jr = 0; jr < nc; jr += NR) {
+            int nr = std::min(NR, nc - jr);
+            const float *b = packed_B + (size_t)jr * kc;
+            for (int ir = 0; ir < mc; ir += MR)
+                block_kernel(kc, packed_A + (size_t)ir * kc, b, C + (size_t)ir * ldc + jr, ldc,
+                             std::min(MR, mc - ir), nr, alpha, beta, ep, i0 + ir, j0 + jr);
+        }
+    }
+}
+
+static int round_up(int x, int multiple) {
+    return (x + multiple - 1) / multiple * multiple;
+}
+
+static GemmConfig sanitize(GemmConfig cfg) {
+    cfg.kc = std::max(1, cfg.kc);
+    cfg.mc = round_up(std::max(1, cfg.mc), MR);
+    cfg.nc = round_up(std::max(1, cfg.nc), NR);
+    if (cfg.loop_order != LOOP_IR_JR)
+        cfg.loop_order = LOOP_JR_IR;
+    return cfg;
+}
+
+// Tuned config for this CPU if one was saved, else the cache-geometry model
+static GemmConfig &current_config() {
+    static GemmConfig cfg = [] {
+        GemmConfig c;
+        if (!load_tuned_config(c))
+            c = model_config(detect_caches());
+        return sanitize(c);
+    }();
+    return cfg;
+}
+
+int gemm_mr() { return MR; }
+int gemm_nr() { return NR; }
+
+GemmConfig gemm_get_config() {
+    return current_config();
+}
+
+void gemm_set_config(const GemmConfig &cfg) {
+    current_config() = sanitize(cfg);
+}
+
+GemmConfig gemm_fallback_config() {
+    return GemmConfig{TILE_L1, TILE_L2, TILE_L3, LOOP_JR_IR};
+}
+
+// Untuned machines: a slow fork/join and a modest core, so small calls stay
+// on few threads rather than paying for a team they cannot use
+GemmCostModel gemm_default_cost_model() {
+    return GemmCostModel{5.0, 40.0, 40.0 * omp_get_num_procs(), 10.0, 40.0};
+}
+
+static GemmCostModel sanitize(GemmCostModel model) {
+    const GemmCostModel fallback = gemm_default_cost_model();
+    if (!(model.fork_join_us >= 0.0)) model.fork_join_us = fallback.fork_join_us;
+    if (!(model.core_gflops > 0.0)) model.core_gflops = fallback.core_gflops;
+    if (!(model.socket_gflops >= model.core_gflops)) model.socket_gflops = model.core_gflops;
+    if (!(model.core_gbs > 0.0)) model.core_gbs = fallback.core_gbs;
+    if (!(model.socket_gbs >= model.core_gbs)) model.socket_gbs = model.core_gbs;
+    return model;
+}
+
+static GemmCostModel &current_cost_model() {
+    static GemmCostModel model = [] {
+        GemmCostModel c;
+        if (!load_tuned_cost_model(c))
+            c = gemm_default_cost_model();
+        return sanitize(c);
+    }();
+    return model;
+}
+
+GemmCostModel gemm_get_cost_model() {
+    return current_cost_model();
+}
+
+void gemm_set_cost_model(const GemmCostModel &model) {
+    current_cost_model() = sanitize(model);
+}
+
+// Packed-panel GEMM: B panels are packed once per (jc, pc) and shared by the
+// team, every thread packs its own A block and sweeps it with the microkernel.
+// beta is applied by the first k-block only; later blocks accumulate, and
+// the last one runs the epilogue (if any) on each finished tile.
+// Runs on a team of num_threads; with one thread it is safe to call from
+// inside another parallel region. 16-bit operands are widened while packing,
+// so the microkernel always sees fp32 panels. mc (0: the tuned one) and the
+// schedule of the row-block loop come from the plan.
+template <typename T>
+static void gemm_packed(bool transa, bool transb, int m, int n, int k,
+                        float alpha, const T *A, int lda,
+                        const T *B, int ldb,
+                        float beta, float *C, int ldc, int num_threads,
+                        const GemmEpilogue *ep = nullptr, int mc_plan = 0,
+                        int schedule = GEMM_SCHEDULE_DYNAMIC) {
+    GemmConfig cfg = current_config();
+    if (mc_plan > 0)
+        cfg.mc = std::min(cfg.mc, round_up(mc_plan, MR));
+    float *packed_B = aligned_buffer((size_t)cfg.kc * cfg.nc);
+
+    #pragma omp parallel num_threads(num_threads) if(num_threads > 1)
+    {
+        float *packed_A = aligned_buffer((size_t)cfg.mc * cfg.kc);
+
+        for (int jc = 0; jc < n; jc += cfg.nc) {
+            int nc = std::min(cfg.nc, n - jc);
+            for (int pc = 0; pc < k; pc += cfg.kc) {
+                int kc = std::min(cfg.kc, k - pc);
+                float beta_pc = pc == 0 ? beta : 1.0f;
+                const GemmEpilogue *ep_pc = pc + kc >= k ? ep : nullptr;
+
+                pack_B(B, ldb, transb, pc, jc, kc, nc, packed_B);
+
+                auto row_block = [&](int ic) {
+                    int mc = std::min(cfg.mc, m - ic);
+                    pack_A(A, lda, transa, ic, pc, mc, kc, packed_A);
+                    macro_kernel(mc, nc, kc, packed_A, packed_B, C + (size_t)ic * ldc + jc, ldc,
+                                 alpha, beta_pc, cfg.loop_order, ep_pc, ic, jc);
+                };
+                if (schedule == GEMM_SCHEDULE_STATIC) {
+                    #pragma omp for schedule(static)
+                    for (int ic = 0; ic < m; ic += cfg.mc)
+                        row_block(ic);
+                } else {
+                    #pragma omp for schedule(dynamic)
+                    for (int ic = 0; ic < m; ic += cfg.mc)
+                        row_block(ic);
+                }  // implicit barrier before packed_B is overwritten
+            }
+        }
+
+        std::free(packed_A);
+    }
+
+    std::free(packed_B);
+}
+
+static int split_k_mode = SPLIT_K_AUTO;
+static int thread_mode = GEMM_THREADS_PLANNED;
+
+void gemm_set_split_k(int mode) {
+    split_k_mode = mode;
+}
+
+void gemm_set_thread_mode(int mode) {
+    thread_mode = mode;
+}
+
+// Split-K pays off when the output has fewer MC row blocks than threads (so
+// the normal path leaves cores idle) and K dominates the shape, as long as
+// the per-thread partial C buffers stay reasonably small.
+static bool use_split_k(int m, int n, int k, int num_threads, const GemmConfig &cfg) {
+    if (split_k_mode == SPLIT_K_NEVER || num_threads < 2 || k < 2 * cfg.kc)
+        return false;
+    if (split_k_mode == SPLIT_K_ALWAYS)
+        return true;
+    int mn_blocks = (m + cfg.mc - 1) / cfg.mc;
+    size_t workspace = (size_t)num_threads * m * n * sizeof(float);
+    return mn_blocks < num_threads && k > std::max(m, n) && workspace <= ((size_t)256 << 20);
+}
+
+// Split-K: thread t owns a kc-aligned slice of K and computes
+// alpha * op(A)[:, slice] * op(B)[slice, :] into a private m x n buffer with
+// no shared writes. The partials are then summed by a parallel tree
+// reduction (level s adds buffer t + s into t for every t % 2s == 0) and
+// the last step folds in beta * C and the epilogue. No atomics, every core busy even when
+// M x N is a single tile.
+template <typename T>
+static void gemm_split_k(bool transa, bool transb, int m, int n, int k,
+                         float alpha, const T *A, int lda,
+                         const T *B, int ldb,
+                         float beta, float *C, int ldc, int num_threads,
+                         const GemmEpilogue *ep) {
+    const int kc = current_config().kc;
+    // A pinned team keeps every thread even when some get no kc block
+    int slices = thread_mode == GEMM_THREADS_EXACT ? num_threads : std::min(num_threads, (k + kc - 1) / kc);
+    int ldw = (n + 15) / 16 * 16;
+    size_t stride = (size_t)m * ldw;
+    float *partials = aligned_buffer(stride * slices);
+
+    #pragma omp parallel num_threads(slices)
+    {
+        int nt = omp_get_num_threads();
+        int t = omp_get_thread_num();
+
+        // kc-aligned slice boundaries so every slice packs whole blocks
+        int blocks = (k + kc - 1) / kc;
+        int k0 = std::min(k, blocks * t / nt * kc);
+        int k1 = std::min(k, blocks * (t + 1) / nt * kc);
+        float *W = partials + stride * t;
+        if (k1 > k0) {
+            const T *A_slice = transa ? A + (size_t)k0 * lda : A + k0;
+            const T *B_slice = transb ? B + k0 : B + (size_t)k0 * ldb;
+            gemm_packed(transa, transb, m, n, k1 - k0, alpha, A_slice, lda, B_slice, ldb,
+                        0.0f, W, ldw, 1);
+        } else {
+            for (size_t i = 0; i < stride; ++i)
+                W[i] = 0.0f;
+        }
+        #pragma omp barrier
+
+        for (int s = 1; s < nt; s *= 2) {
+            int pairs = (nt + 2 * s - 1) / (2 * s);
+            #pragma omp for schedule(static)
+            for (int idx = 0; idx < pairs * m; ++idx) {
+                int dst = idx / m * 2 * s;
+                int src = dst + s;
+                if (src >= nt)
+                    continue;
+                float *wd = partials + stride * dst + (size_t)(idx % m) * ldw;
+                const float *ws = partials + stride * src + (size_t)(idx % m) * ldw;
+                #pragma omp simd
+                for (int j = 0; j < n; ++j)
+                    wd[j] += ws[j];
+            }
+        }
+
+        #pragma omp for schedule(static)
+        for (int i = 0; i < m; ++i) {
+            const float *wi = partials + (size_t)i * ldw;
+            float *ci = C + (size_t)i * ldc;
+            if (beta == 0.0f) {
+                for (int j = 0; j < n; ++j)
+                    ci[j] = wi[j];
+            } else {
+                #pragma omp simd
+                for (int j = 0; j < n; ++j)
+                    ci[j] = wi[j] + beta * ci[j];
+            }
+            if (ep)
+                apply_epilogue(ci, ldc, 1, n, i, 0, *ep);
+        }
+    }
+
+    std::free(partials);
+}
+
+// Matrix-vector shapes read the matrix operand once and do two flops per
+// element, so they are bound by memory bandwidth and the packed engine's
+// panel copies only add traffic. Whichever of m or n is 1, every output
+// element is either a dot product with a stored row (gemv_dot) or a sum of
+// scaled stored rows (gemv_axpy), so all four transpose combinations stream
+// contiguous rows.
+const int GEMV_STRIP = 1024;        // output columns per gemv_axpy accumulator (4 KB, stays in L1)
+const int GEMV_MIN_SPLIT = 4096;    // shortest row part worth its own partial sum
+
+static inline float axpby(float alpha, float acc, float beta, float y) {
+    return beta == 0.0f ? alpha * acc : alpha * acc + beta * y;
+}
+
+// y[i * incy] = alpha * dot(row i of M, x) + beta * y[i * incy] for rows of
+// length len. With fewer rows than threads each row is cut into parts whose
+// partial sums are added afterwards.
+template <typename T>
+static void gemv_dot(int rows, int len, float alpha, const T *M, int ldm, const float *x,
+                     float beta, float *y, int incy, int num_threads) {
+    const int parts = std::max(1, std::min(num_threads / rows, len / GEMV_MIN_SPLIT));
+    std::vector<float> partial(parts > 1 ? (size_t)rows * parts : 0);
+
+    #pragma omp parallel for collapse(2) schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (int i = 0; i < rows; ++i)
+        for (int q = 0; q < parts; ++q) {
+            const int p0 = (int)((long)len * q / parts), p1 = (int)((long)len * (q + 1) / parts);
+            const T *mi = M + (size_t)i * ldm;
+            float sum = 0.0f;
+            #pragma omp simd reduction(+ : sum)
+            for (int p = p0; p < p1; ++p)
+                sum += to_float(mi[p]) * x[p];
+            if (parts == 1)
+                y[(size_t)i * incy] = axpby(alpha, sum, beta, y[(size_t)i * incy]);
+            else
+                partial[(size_t)i * parts + q] = sum;
+        }
+
+    if (parts > 1)
+        for (int i = 0; i < rows; ++i) {
+            float sum = 0.0f;
+            for (int q = 0; q < parts; ++q)
+                sum += partial[(size_t)i * parts + q];
+            y[(size_t)i * incy] = axpby(alpha, sum, beta, y[(size_t)i * incy]);
+        }
+}
+
+// y[j * incy] = alpha * sum_p x[p] * M[p][j] + beta * y[j * incy] for len
+// columns. Each task accumulates a GEMV_STRIP-column strip over its rows,
+// four rows per pass; with fewer strips than threads the rows are split too
+// and the partial strips summed.
+template <typename T>
+static void gemv_axpy(int rows, int len, float alpha, const T *M, int ldm, const float *x,
+                      float beta, float *y, int incy, int num_threads) {
+    const int strips = (len + GEMV_STRIP - 1) / GEMV_STRIP;
+    const int parts = std::max(1, std::min(num_threads / strips, (int)((long)rows * len / GEMV_MIN_SPLIT)));
+    std::vector<float> partial(parts > 1 ? (size_t)parts * len : 0);
+
+    #pragma omp parallel for collapse(2) schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (int s = 0; s < strips; ++s)
+        for (int q = 0; q < parts; ++q) {
+            const int j0 = s * GEMV_STRIP, nj = std::min(GEMV_STRIP, len - j0);
+            const int p0 = (int)((long)rows * q / parts), p1 = (int)((long)rows * (q + 1) / parts);
+            alignas(64) float acc[GEMV_STRIP];
+            std::fill(acc, acc + nj, 0.0f);
+            int p = p0;
+            for (; p + 4 <= p1; p += 4) {
+                const T *r0 = M + (size_t)p * ldm + j0, *r1 = r0 + ldm, *r2 = r1 + ldm, *r3 = r2 + ldm;
+                const float x0 = x[p], x1 = x[p + 1], x2 = x[p + 2], x3 = x[p + 3];
+                #pragma omp simd
+                for (int j = 0; j < nj; ++j)
+                    acc[j] += x0 * to_float(r0[j]) + x1 * to_float(r1[j]) + x2 * to_float(r2[j]) +
+                              x3 * to_float(r3[j]);
+            }
+            for (; p < p1; ++p) {
+                const T *r = M + (size_t)p * ldm + j0;
+                const float xp = x[p];
+                #pragma omp simd
+                for (int j = 0; j < nj; ++j)
+                    acc[j] += xp * to_float(r[j]);
+            }
+            if (parts == 1) {
+                for (int j = 0; j < nj; ++j)
+                    y[(size_t)(j0 + j) * incy] = axpby(alpha, acc[j], beta, y[(size_t)(j0 + j) * incy]);
+            } else {
+                std::copy(acc, acc + nj, partial.data() + (size_t)q * len + j0);
+            }
+        }
+
+    if (parts > 1) {
+        #pragma omp parallel for schedule(static) num_threads(num_threads)
+        for (int j = 0; j < len; ++j) {
+            float sum = 0.0f;
+            for (int q = 0; q < parts; ++q)
+                sum += partial[(size_t)q * len + j];
+            y[(size_t)j * incy] = axpby(alpha, sum, beta, y[(size_t)j * incy]);
+        }
+    }
+}
+
+// m == 1 or n == 1. The vector operand is gathered (and widened) into a
+// contiguous buffer first; it is k elements against the matrix's k * max(m, n).
+template <typename T>
+static void gemm_gemv(bool transa, bool transb, int m, int n, int k,
+                      float alpha, const T *A, int lda,
+                      const T *B, int ldb,
+                      float beta, float *C, int ldc, int num_threads,
+                      const GemmEpilogue *ep) {
+    std::vector<float> x(k);
+    if (n == 1) {
+        // C column = op(A) * (column of op(B))
+        for (int p = 0; p < k; ++p)
+            x[p] = to_float(transb ? B[p] : B[(size_t)p * ldb]);
+        if (transa)
+            gemv_axpy(k, m, alpha, A, lda, x.data(), beta, C, ldc, num_threads);
+        else
+            gemv_dot(m, k, alpha, A, lda, x.data(), beta, C, ldc, num_threads);
+    } else {
+        // C row = (row of op(A)) * op(B)
+        for (int p = 0; p < k; ++p)
+            x[p] = to_float(transa ? A[(size_t)p * lda] : A[p]);
+        if (transb)
+            gemv_dot(n, k, alpha, B, ldb, x.data(), beta, C, 1, num_threads);
+        else
+            gemv_axpy(k, n, alpha, B, ldb, x.data(), beta, C, 1, num_threads);
+    }
+    if (ep)
+        apply_epilogue(C, ldc, m, n, 0, 0, *ep);
+}
+
+// k == 1: C = alpha * a b^T + beta * C, a rank-1 update that streams C once.
+// Rows are cut into GEMV_STRIP-column strips so that a short, wide C still
+// spreads over the team, and the epilogue runs on each strip as it is written.
+template <typename T>
+static void gemm_ger(bool transa, bool transb, int m, int n,
+                     float alpha, const T *A, int lda,
+                     const T *B, int ldb,
+                     float beta, float *C, int ldc, int num_threads,
+                     const GemmEpilogue *ep) {
+    std::vector<float> a(m), b(n);
+    for (int i = 0; i < m; ++i)
+        a[i] = alpha * to_float(transa ? A[i] : A[(size_t)i * lda]);
+    for (int j = 0; j < n; ++j)
+        b[j] = to_float(transb ? B[(size_t)j * ldb] : B[j]);
+    const int strips = (n + GEMV_STRIP - 1) / GEMV_STRIP;
+
+    #pragma omp parallel for collapse(2) schedule(static) num_threads(num_threads) if(num_threads > 1)
+    for (int i = 0; i < m; ++i)
+        for (int s = 0; s < strips; ++s) {
+            const int j0 = s * GEMV_STRIP, nj = std::min(GEMV_STRIP, n - j0);
+            const float ai = a[i];
+            const float *bj = b.data() + j0;
+            float *ci = C + (size_t)i * ldc + j0;
+            if (beta == 0.0f) {
+                #pragma omp simd
+                for (int j = 0; j < nj; ++j)
+                    ci[j] = ai * bj[j];
+            } else {
+                #pragma omp simd
+                for (int j = 0; j < nj; ++j)
+                    ci[j] = ai * bj[j] + beta * ci[j];
+            }
+            if (ep)
+                apply_epilogue(ci, ldc, 1, nj, i, j0, *ep);
+        }
+}
+
+// Fork/join plus barriers of a parallel region; a single thread runs inline
+static double sync_seconds(const GemmCostModel &cm, int threads, int barriers) {
+    return threads > 1 ? cm.fork_join_us * 1e-6 * (1 + barriers) : 0.0;
+}
+
+// Bandwidth-bound paths: t threads stream at t cores' bandwidth up to the socket's
+static double stream_seconds(const GemmCostModel &cm, double bytes, int threads) {
+    return bytes / (std::min(threads * cm.core_gbs, cm.socket_gbs) * 1e9) + sync_seconds(cm, threads, 1);
+}
+
+// Per-thread FLOP rate of a team of t
+static double thread_flop_rate(const GemmCostModel &cm, int threads) {
+    return std::min(cm.core_gflops, cm.socket_gflops / threads) * 1e9;
+}
+
+// Thread counts are tried in increasing order and a bigger team must save at
+// least this fraction of the time, so the model's noise favours fewer threads
+const double PLAN_MIN_GAIN = 0.05;
+
+GemmPlan gemm_plan(int m, int n, int k) {
+    const GemmCostModel cm = current_cost_model();
+    const GemmConfig cfg = current_config();
+    const int max_threads = std::max(1, omp_get_max_threads());
+    GemmPlan plan{GEMM_SHAPE_GEMM, 1, GEMM_SCHEDULE_STATIC, cfg.mc, 0.0};
+    if (m <= 0 || n <= 0 || k <= 0)
+        return plan;
+
+    auto choose = [&](auto seconds_for) {
+        if (thread_mode == GEMM_THREADS_EXACT) {
+            plan.num_threads = max_threads;
+            plan.seconds = seconds_for(max_threads);
+            return;
+        }
+        plan.seconds = seconds_for(1);
+        for (int t = 2; t <= max_threads; ++t) {
+            double s = seconds_for(t);
+            if (s < plan.seconds * (1.0 - PLAN_MIN_GAIN)) {
+                plan.seconds = s;
+                plan.num_threads = t;
+            }
+        }
+    };
+
+    if (m == 1 || n == 1 || k == 1) {
+        plan.shape = k == 1 && m > 1 && n > 1 ? GEMM_SHAPE_GER : GEMM_SHAPE_GEMV;
+        const double bytes = plan.shape == GEMM_SHAPE_GER ? 2.0 * sizeof(float) * m * n
+                                                         : (double)sizeof(float) * k * std::max(m, n);
+        choose([&](int t) { return stream_seconds(cm, bytes, t); });
+        return plan;
+    }
+
+    const double flops = 2.0 * m * n * (double)k;
+    if (use_split_k(m, n, k, max_threads, cfg)) {
+        // One slice per thread, then a log2(t)-level tree over private m x n partials
+        const int slices = std::min(max_threads, (k + cfg.kc - 1) / cfg.kc);
+        const double partial_bytes = 2.0 * sizeof(float) * m * n;
+        choose([&](int t) {
+            if (t > slices && thread_mode != GEMM_THREADS_EXACT)
+                return 1e30;
+            int levels = 0;
+            while ((1 << levels) < t)
+                ++levels;
+            return flops / (t * thread_flop_rate(cm, t)) + partial_bytes * levels / (cm.core_gbs * 1e9) +
+                   sync_seconds(cm, t, levels + 1);
+        });
+        if (plan.num_threads > 1)
+            plan.shape = GEMM_SHAPE_SPLIT_K;
+        return plan;
+    }
+
+    // Row blocks shrink (down to one MR panel) until every thread has one; a
+    // thread runs ceil(blocks / t) of them and the team meets twice per kc x nc panel
+    const int panels = ((n + cfg.nc - 1) / cfg.nc) * ((k + cfg.kc - 1) / cfg.kc);
+    auto block_rows = [&](int t) { return std::min(cfg.mc, round_up((m + t - 1) / t, MR)); };
+    choose([&](int t) {
+        const int mc = block_rows(t);
+        const int rounds = ((m + mc - 1) / mc + t - 1) / t;
+        return rounds * (2.0 * mc * n * (double)k) / thread_flop_rate(cm, t) + sync_seconds(cm, t, 2 * panels);
+    });
+
+    plan.mc = block_rows(plan.num_threads);
+    const int blocks = (m + plan.mc - 1) / plan.mc;
+    // Static only when every thread gets the same number of full blocks
+    plan.schedule = blocks % plan.num_threads == 0 && m % plan.mc == 0 ? GEMM_SCHEDULE_STATIC
+                                                                       : GEMM_SCHEDULE_DYNAMIC;
+    return plan;
+}
+
+const char *gemm_shape_name(int shape) {
+    switch (shape) {
+    case GEMM_SHAPE_GEMV: return "gemv";
+    case GEMM_SHAPE_GER: return "ger";
+    case GEMM_SHAPE_SPLIT_K: return "split-k";
+    default: return "gemm";
+    }
+}
+
+static bool parse_trans(char t, bool &trans) {
+    if (t == 'N' || t == 'n') {
+        trans = false;
+        return true;
+    }
+    if (t == 'T' || t == 't' || t == 'C' || t == 'c') {
+        trans = true;
+        return true;
+    }
+    return false;
+}
+
+static bool valid_epilogue(const GemmEpilogue &ep) {
+    if (ep.bias_mode != GEMM_BIAS_NONE && ep.bias_mode != GEMM_BIAS_ROW && ep.bias_mode != GEMM_BIAS_COL)
+        return false;
+    if (ep.bias_mode != GEMM_BIAS_NONE && !ep.bias)
+        return false;
+    return ep.activation == GEMM_ACT_NONE || ep.activation == GEMM_ACT_RELU || ep.activation == GEMM_ACT_GELU;
+}
+
+// Argument checks and path selection shared by the fp32 and 16-bit entries
+template <typename T>
+static int gemm_typed(char transa, char transb, int m, int n, int k,
+                      float alpha, const T *A, int lda,
+                      const T *B, int ldb,
+                      float beta, float *C, int ldc,
+                      const GemmEpilogue *ep = nullptr) {
+    bool ta, tb;
+    if (!parse_trans(transa, ta)) return -1;
+    if (!parse_trans(transb, tb)) return -2;
+    if (m < 0) return -3;
+    if (n < 0) return -4;
+    if (k < 0) return -5;
+    if (lda < std::max(1, ta ? m : k)) return -8;
+    if (ldb < std::max(1, tb ? k : n)) return -10;
+    if (ldc < std::max(1, n)) return -13;
+    if (ep && !valid_epilogue(*ep)) return -14;
+
+    if (m == 0 || n == 0)
+        return 0;
+    if (k == 0 || alpha == 0.0f) {
+        if (beta != 1.0f)
+            scale_C(m, n, beta, C, ldc);
+        if (ep) {
+            #pragma omp parallel for schedule(static)
+            for (int i = 0; i < m; ++i)
+                apply_epilogue(C + (size_t)i * ldc, ldc, 1, n, i, 0, *ep);
+        }
+        return 0;
+    }
+
+    const GemmPlan plan = gemm_plan(m, n, k);
+    switch (plan.shape) {
+    case GEMM_SHAPE_GEMV:
+        gemm_gemv(ta, tb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, plan.num_threads, ep);
+        break;
+    case GEMM_SHAPE_GER:
+        gemm_ger(ta, tb, m, n, alpha, A, lda, B, ldb, beta, C, ldc, plan.num_threads, ep);
+        break;
+    case GEMM_SHAPE_SPLIT_K:
+        gemm_split_k(ta, tb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, plan.num_threads, ep);
+        break;
+    default:
+        gemm_packed(ta, tb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, plan.num_threads, ep,
+                    plan.mc, plan.schedule);
+    }
+    return 0;
+}
+
+int sgemm(char transa, char transb, int m, int n, int k,
+          float alpha, const float *A, int lda,
+          const float *B, int ldb,
+          float beta, float *C, int ldc) {
+    return gemm_typed(transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+int sgemm_epilogue(char transa, char transb, int m, int n, int k,
+                   float alpha, const float *A, int lda,
+                   const float *B, int ldb,
+                   float beta, float *C, int ldc,
+                   const GemmEpilogue &epilogue) {
+    return gemm_typed(transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc, &epilogue);
+}
+
+int gemm_bf16bf16f32(char transa, char transb, int m, int n, int k,
+                     float alpha, const bf16_t *A, int lda,
+                     const bf16_t *B, int ldb,
+                     float beta, float *C, int ldc) {
+    return gemm_typed(transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+int gemm_f16f16f32(char transa, char transb, int m, int n, int k,
+                   float alpha, const fp16_t *A, int lda,
+                   const fp16_t *B, int ldb,
+                   float beta, float *C, int ldc) {
+    return gemm_typed(transa, transb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+void gemm_float_to_bf16(const float *src, bf16_t *dst, size_t count) {
+    size_t i = 0;
+#if defined(__AVX512BF16__)
+    for (; i + 16 <= count; i += 16)
+        _mm256_storeu_si256((__m256i *)(dst + i), (__m256i)_mm512_cvtneps_pbh(_mm512_loadu_ps(src + i)));
+#endif
+    for (; i < count; ++i)
+        dst[i] = to_bf16(src[i]);
+}
+
+void gemm_bf16_to_float(const bf16_t *src, float *dst, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+        dst[i] = to_float(src[i]);
+}
+
+void gemm_float_to_f16(const float *src, fp16_t *dst, size_t count) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8)
+        _mm_storeu_si128((__m128i *)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    for (; i < count; ++i)
+        dst[i] = to_f16(src[i]);
+}
+
+void gemm_f16_to_float(const fp16_t *src, float *dst, size_t count) {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= count; i += 8)
+        _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(src + i))));
+#endif
+    for (; i < count; ++i)
+        dst[i] = to_float(src[i]);
+}
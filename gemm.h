@@ -0,0 +1,202 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Single-precision GEMM on caller-owned, row-major buffers:
+//
+//     C = alpha * op(A) * op(B) + beta * C
+//
+// op(A) is m x k, op(B) is k x n and C is m x n. transa/transb are 'N' or 'T'
+// (op(X) = X or X^T). Leading dimensions are row strides in elements, so a
+// non-transposed A needs lda >= k and a transposed one lda >= m. When beta is
+// zero C is write-only and may hold garbage on entry.
+//
+// Returns 0 on success or -i when the i-th argument is invalid (LAPACK style).
+int sgemm(char transa, char transb, int m, int n, int k,
+          float alpha, const float *A, int lda,
+          const float *B, int ldb,
+          float beta, float *C, int ldc);
+
+// Fused epilogue: sgemm_epilogue computes
+//
+//     C = act(alpha * op(A) * op(B) + beta * C + bias)
+//
+// with the bias and activation applied to each C tile right after its last
+// k-block, while the tile is still in L1, instead of in extra passes over C.
+// bias holds one value per row of C (m entries) or per column (n entries).
+// GELU is the tanh approximation, x * sigmoid(1.5958 * (x + 0.044715 x^3)).
+enum GemmBiasMode {
+    GEMM_BIAS_NONE = 0,
+    GEMM_BIAS_ROW = 1,      // C[i][j] += bias[i]
+    GEMM_BIAS_COL = 2       // C[i][j] += bias[j]
+};
+
+enum GemmActivation {
+    GEMM_ACT_NONE = 0,
+    GEMM_ACT_RELU = 1,
+    GEMM_ACT_GELU = 2
+};
+
+struct GemmEpilogue {
+    int bias_mode;          // GemmBiasMode
+    const float *bias;
+    int activation;         // GemmActivation
+};
+
+// Same contract as sgemm; returns -14 for an invalid epilogue (unknown mode
+// or activation, or a bias mode without a bias array).
+int sgemm_epilogue(char transa, char transb, int m, int n, int k,
+                   float alpha, const float *A, int lda,
+                   const float *B, int ldb,
+                   float beta, float *C, int ldc,
+                   const GemmEpilogue &epilogue);
+
+// Batched sgemm: batch_count independent products with one shared shape,
+// alpha and beta, C[i] = alpha * op(A[i]) * op(B[i]) + beta * C[i]. Entries
+// come from pointer arrays or from base pointers plus a per-entry stride in
+// elements (a stride of 0 reuses one operand across the batch). Products of
+// up to 64 x 64 x 64 are spread over the OpenMP threads, each entry on one
+// thread through an unrolled kernel for its shape; larger ones call sgemm
+// in turn.
+// Output entries must not overlap. Returns 0 or -i for an invalid i-th argument.
+int sgemm_batch(char transa, char transb, int m, int n, int k,
+                float alpha, const float *const *A, int lda,
+                const float *const *B, int ldb,
+                float beta, float *const *C, int ldc, int batch_count);
+int sgemm_batch_strided(char transa, char transb, int m, int n, int k,
+                        float alpha, const float *A, int lda, ptrdiff_t stride_a,
+                        const float *B, int ldb, ptrdiff_t stride_b,
+                        float beta, float *C, int ldc, ptrdiff_t stride_c, int batch_count);
+
+// Low-precision integer GEMM with int32 accumulation on row-major buffers:
+//
+//     C = A * B          (accumulate == false)
+//     C = A * B + C      (accumulate == true)
+//
+// A is m x k, B is k x n, C is m x n int32. u8 x s8 uses AVX-512 VNNI
+// vpdpbusd when available; otherwise it falls back to vpmaddubsw + vpmaddwd,
+// whose int16 intermediate saturates. That path is exact only while each
+// pair a[k]*b[k] + a[k+1]*b[k+1] fits in int16, which holds e.g. for values
+// 0-9 (and for any |a| * |b| <= 16383). s16 x s16 uses vpdpwssd / vpmaddwd
+// and is exact except for the (-32768)^2 * 2 corner case.
+// Returns 0 or -i for an invalid i-th argument.
+int gemm_u8s8s32(int m, int n, int k, const uint8_t *A, int lda, const int8_t *B, int ldb,
+                 bool accumulate, int32_t *C, int ldc);
+int gemm_s16s16s32(int m, int n, int k, const int16_t *A, int lda, const int16_t *B, int ldb,
+                   bool accumulate, int32_t *C, int ldc);
+
+// 16-bit storage formats, kept as raw bit patterns: bfloat16 (8-bit exponent,
+// 7-bit mantissa) and IEEE 754 binary16.
+struct bf16_t { uint16_t bits; };
+struct fp16_t { uint16_t bits; };
+
+// Mixed-precision GEMM: same contract as sgemm, but A and B are stored in
+// 16 bits. Elements are widened to fp32 while packing and all products
+// accumulate in fp32, so only the input rounding differs from sgemm while
+// the streamed operand bytes are halved.
+int gemm_bf16bf16f32(char transa, char transb, int m, int n, int k,
+                     float alpha, const bf16_t *A, int lda,
+                     const bf16_t *B, int ldb,
+                     float beta, float *C, int ldc);
+int gemm_f16f16f32(char transa, char transb, int m, int n, int k,
+                   float alpha, const fp16_t *A, int lda,
+                   const fp16_t *B, int ldb,
+                   float beta, float *C, int ldc);
+
+// Array conversions, round-to-nearest-even (AVX-512 BF16 / F16C when compiled in)
+void gemm_float_to_bf16(const float *src, bf16_t *dst, size_t count);
+void gemm_bf16_to_float(const bf16_t *src, float *dst, size_t count);
+void gemm_float_to_f16(const float *src, fp16_t *dst, size_t count);
+void gemm_f16_to_float(const fp16_t *src, float *dst, size_t count);
+
+// Order of the two innermost (register-block) loops of the macro-kernel
+enum GemmLoopOrder {
+    LOOP_JR_IR = 0,     // sweep A micro-panels against one B micro-panel (B stays in L1)
+    LOOP_IR_JR = 1      // sweep B micro-panels against one A micro-panel (A stays in L1)
+};
+
+// Blocking parameters of the packed engine. The first sgemm call loads them
+// from the autotuner's config file for this CPU model (see autotune.h), or
+// derives them from the cache geometry when the CPU has not been tuned.
+struct GemmConfig {
+    int kc;             // TILE_L1: depth of a packed micro-panel
+    int mc;             // TILE_L2: rows of A per packed block (multiple of MR)
+    int nc;             // TILE_L3: columns of B per packed panel (multiple of NR)
+    int loop_order;     // GemmLoopOrder
+};
+
+// Split-K parallelization for tall-K shapes (small M x N, huge K): threads
+// own slices of K, accumulate into private C buffers and merge them with a
+// parallel tree reduction instead of sharing C.
+enum GemmSplitKMode {
+    SPLIT_K_AUTO = 0,   // when M x N has fewer row blocks than threads and K dominates
+    SPLIT_K_NEVER = 1,
+    SPLIT_K_ALWAYS = 2
+};
+
+void gemm_set_split_k(int mode);
+
+// Register block of the compiled microkernel
+int gemm_mr();
+int gemm_nr();
+
+// Current blocking; gemm_set_config rounds mc/nc up to MR/NR and must not be
+// called while an sgemm is running.
+GemmConfig gemm_get_config();
+void gemm_set_config(const GemmConfig &cfg);
+
+// Machine constants behind sgemm's choice of path, thread count and schedule.
+// Like the blocking, they are measured by the autotuner and loaded from its
+// config file (see autotune.h); an untuned CPU gets conservative defaults.
+struct GemmCostModel {
+    double fork_join_us;    // parallel region plus one barrier on the full team
+    double core_gflops;     // packed engine on one thread
+    double socket_gflops;   // packed engine on the full team: shared cores, SMT and clocks cap it
+    double core_gbs;        // streaming read bandwidth of one thread
+    double socket_gbs;      // of the full team: memory-bound paths stop scaling here
+};
+
+GemmCostModel gemm_default_cost_model();
+GemmCostModel gemm_get_cost_model();
+void gemm_set_cost_model(const GemmCostModel &model);
+
+// How sgemm runs a call, by shape:
+enum GemmShape {
+    GEMM_SHAPE_GEMM = 0,        // packed engine
+    GEMM_SHAPE_GEMV = 1,        // m == 1 or n == 1: one streaming pass over the matrix operand
+    GEMM_SHAPE_GER = 2,         // k == 1: rank-1 update, one streaming pass over C
+    GEMM_SHAPE_SPLIT_K = 3      // small m x n, long k (see GemmSplitKMode)
+};
+
+enum GemmSchedule {
+    GEMM_SCHEDULE_STATIC = 0,   // equal blocks, one round per thread: no dispatch, no imbalance
+    GEMM_SCHEDULE_DYNAMIC = 1   // ragged last block or several rounds: first come, first served
+};
+
+struct GemmPlan {
+    int shape;          // GemmShape
+    int num_threads;    // 1 .. omp_get_max_threads()
+    int schedule;       // GemmSchedule of the row-block loop
+    int mc;             // rows per block: the tuned mc, shrunk so that every thread gets one
+    double seconds;     // predicted by the cost model
+};
+
+// Who picks sgemm's thread count:
+enum GemmThreadMode {
+    GEMM_THREADS_PLANNED = 0,   // the cost model, up to omp_get_max_threads()
+    GEMM_THREADS_EXACT = 1      // always omp_get_max_threads(), e.g. for thread-scaling sweeps
+};
+
+void gemm_set_thread_mode(int mode);
+
+// The plan sgemm follows for an m x n x k product with the current team size.
+// The thread count is the one that minimizes compute plus fork/join and
+// barrier time, so small and skinny products use fewer threads than the
+// machine has; GEMM_THREADS_EXACT pins it to omp_get_max_threads(). The
+// model describes the packed engine and its GEMV/GER paths only.
+GemmPlan gemm_plan(int m, int n, int k);
+const char *gemm_shape_name(int shape);
+
+#endif
@@ -0,0 +1,227 @@
+#include "gemm.h"
+
+#include <cstddef>
+#include <algorithm>
+#include <omp.h>
+
+// Batched GEMM for many independent small products. The packed engine's
+// panel copies, buffer allocation and fork/join cost more than the math for
+// a 16 x 16 product, so small batches skip it: one parallel loop runs over the
+// batch, and each product goes to a fully unrolled kernel for its shape, with
+// the C rows it is working on kept in registers.
+
+// Largest m, n or k handled by the small kernels; bigger products go
+// through sgemm one at a time
+const int SMALL_MAX = 64;
+
+// Below this much work per call the batch loop stays on the calling thread
+const double PARALLEL_MIN_FLOPS = 1 << 20;
+
+using SmallKernel = void (*)(int m, int n, int k, float alpha, const float *A, int lda,
+                             const float *B, int ldb, float beta, float *C, int ldc);
+
+static bool parse_trans(char t, bool &trans) {
+    if (t == 'N' || t == 'n') {
+        trans = false;
+        return true;
+    }
+    if (t == 'T' || t == 't' || t == 'C' || t == 'c') {
+        trans = true;
+        return true;
+    }
+    return false;
+}
+
+// C = alpha * acc + beta * C for one row; beta == 0 never reads C
+template <int N>
+static inline void store_row(const float *acc, float alpha, float beta, float *c) {
+    if (beta == 0.0f) {
+        #pragma omp simd
+        for (int j = 0; j < N; ++j)
+            c[j] = alpha * acc[j];
+    } else {
+        #pragma omp simd
+        for (int j = 0; j < N; ++j)
+            c[j] = alpha * acc[j] + beta * c[j];
+    }
+}
+
+// M x N x K with every bound known at compile time. RB rows of C (at most
+// 128 floats, 8 zmm) accumulate over all of K before they are stored, so
+// each element of B is loaded once per RB rows and C is touched once.
+template <int M, int N, int K>
+static void small_kernel(int, int, int, float alpha, const float *A, int lda,
+                         const float *B, int ldb, float beta, float *C, int ldc) {
+    constexpr int RB = std::min(M, std::max(1, 128 / N));
+    static_assert(M % RB == 0, "row block must divide M");
+    for (int i0 = 0; i0 < M; i0 += RB) {
+        alignas(64) float acc[RB][N] = {};
+        #pragma GCC unroll 16
+        for (int p = 0; p < K; ++p) {
+            const float *b = B + (size_t)p * ldb;
+            #pragma GCC unroll 16
+            for (int r = 0; r < RB; ++r) {
+                const float a = A[(size_t)(i0 + r) * lda + p];
+                #pragma omp simd
+                for (int j = 0; j < N; ++j)
+                    acc[r][j] += a * b[j];
+            }
+        }
+        for (int r = 0; r < RB; ++r)
+            store_row<N>(acc[r], alpha, beta, C + (size_t)(i0 + r) * ldc);
+    }
+}
+
+// Any shape up to SMALL_MAX: runtime bounds, one C row at a time
+static void small_generic(int m, int n, int k, float alpha, const float *A, int lda,
+                          const float *B, int ldb, float beta, float *C, int ldc) {
+    for (int i = 0; i < m; ++i) {
+        alignas(64) float acc[SMALL_MAX] = {};
+        const float *a = A + (size_t)i * lda;
+        for (int p = 0; p < k; ++p) {
+            const float *b = B + (size_t)p * ldb;
+            #pragma omp simd
+            for (int j = 0; j < n; ++j)
+                acc[j] += a[p] * b[j];
+        }
+        float *c = C + (size_t)i * ldc;
+        for (int j = 0; j < n; ++j)
+            c[j] = beta == 0.0f ? alpha * acc[j] : alpha * acc[j] + beta * c[j];
+    }
+}
+
+struct SmallShape {
+    int m, n, k;
+    SmallKernel kernel;
+};
+
+// Common small shapes: square powers of two, plus the tall/wide 8- and
+// 16-wide blocks found in batched attention and block-sparse workloads
+static const SmallShape small_shapes[] = {
+    {4, 4, 4, small_kernel<4, 4, 4>},
+    {8, 8, 8, small_kernel<8, 8, 8>},
+    {16, 16, 16, small_kernel<16, 16, 16>},
+    {32, 32, 32, small_kernel<32, 32, 32>},
+    {64, 64, 64, small_kernel<64, 64, 64>},
+    {8, 8, 64, small_kernel<8, 8, 64>},
+    {16, 16, 64, small_kernel<16, 16, 64>},
+    {64, 64, 16, small_kernel<64, 64, 16>},
+    {32, 32, 64, small_kernel<32, 32, 64>},
+    {64, 64, 32, small_kernel<64, 64, 32>},
+};
+
+static SmallKernel select_small_kernel(int m, int n, int k) {
+    for (const SmallShape &s : small_shapes)
+        if (s.m == m && s.n == n && s.k == k)
+            return s.kernel;
+    return small_generic;
+}
+
+// Copies op(X) (rows x cols, X stored transposed) into a contiguous buffer
+static void transpose_into(const float *X, int ldx, int rows, int cols, float *dst) {
+    for (int i = 0; i < rows; ++i)
+        for (int j = 0; j < cols; ++j)
+            dst[i * cols + j] = X[(size_t)j * ldx + i];
+}
+
+// One small product; transposed operands are first copied to the stack so
+// the kernels only ever see unit-stride rows
+static inline void small_gemm(SmallKernel kernel, bool ta, bool tb, int m, int n, int k,
+                              float alpha, const float *A, int lda, const float *B, int ldb,
+                              float beta, float *C, int ldc) {
+    alignas(64) float at[SMALL_MAX * SMALL_MAX];
+    alignas(64) float bt[SMALL_MAX * SMALL_MAX];
+    if (ta) {
+        transpose_into(A, lda, m, k, at);
+        A = at;
+        lda = k;
+    }
+    if (tb) {
+        transpose_into(B, ldb, k, n, bt);
+        B = bt;
+        ldb = n;
+    }
+    kernel(m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+}
+
+// Shared driver; operands(i, A, B, C) yields the pointers of batch entry i
+template <typename Operands>
+static void gemm_batch(bool ta, bool tb, int m, int n, int k, float alpha, int lda, int ldb,
+                       float beta, int ldc, int batch_count, Operands operands) {
+    if (m == 0 || n == 0 || batch_count == 0)
+        return;
+
+    if (m > SMALL_MAX || n > SMALL_MAX || k > SMALL_MAX) {
+        // Each product is big enough to parallelize on its own
+        for (int i = 0; i < batch_count; ++i) {
+            const float *A, *B;
+            float *C;
+            operands(i, A, B, C);
+            sgemm(ta ? 'T' : 'N', tb ? 'T' : 'N', m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+        }
+        return;
+    }
+
+    SmallKernel kernel = select_small_kernel(m, n, k);
+    const double flops = 2.0 * m * n * (double)k * batch_count;
+    const bool parallel = flops >= PARALLEL_MIN_FLOPS && omp_get_max_threads() > 1;
+    #pragma omp parallel for schedule(static) if (parallel)
+    for (int i = 0; i < batch_count; ++i) {
+        const float *A, *B;
+        float *C;
+        operands(i, A, B, C);
+        small_gemm(kernel, ta, tb, m, n, k, alpha, A, lda, B, ldb, beta, C, ldc);
+    }
+}
+
+// ldb_arg/ldc_arg: argument positions, which differ between the two entry points
+static int check_batch_args(char transa, char transb, int m, int n, int k, int lda, int ldb, int ldc,
+                            int ldb_arg, int ldc_arg, bool &ta, bool &tb) {
+    if (!parse_trans(transa, ta)) return -1;
+    if (!parse_trans(transb, tb)) return -2;
+    if (m < 0) return -3;
+    if (n < 0) return -4;
+    if (k < 0) return -5;
+    if (lda < std::max(1, ta ? m : k)) return -8;
+    if (ldb < std::max(1, tb ? k : n)) return -ldb_arg;
+    if (ldc < std::max(1, n)) return -ldc_arg;
+    return 0;
+}
+
+int sgemm_batch(char transa, char transb, int m, int n, int k,
+                float alpha, const float *const *A, int lda,
+                const float *const *B, int ldb,
+                float beta, float *const *C, int ldc, int batch_count) {
+    bool ta, tb;
+    int info = check_batch_args(transa, transb, m, n, k, lda, ldb, ldc, 10, 13, ta, tb);
+    if (info != 0)
+        return info;
+    if (batch_count < 0)
+        return -14;
+    gemm_batch(ta, tb, m, n, k, alpha, lda, ldb, beta, ldc, batch_count,
+               [&](int i, const float *&a, const float *&b, float *&c) {
+                   a = A[i];
+                   b = B[i];
+                   c = C[i];
+               });
+    return 0;
+}
+
+int sgemm_batch_strided(char transa, char transb, int m, int n, int k,
+                        float alpha, const float *A, int lda, ptrdiff_t stride_a,
+                        const float *B, int ldb, ptrdiff_t stride_b,
+                        float beta, float *C, int ldc, ptrdiff_t stride_c, int batch_count) {
+    bool ta, tb;
+    int info = check_batch_args(transa, transb, m, n, k, lda, ldb, ldc, 11, 15, ta, tb);
+    if (info != 0)
+        return info;
+    if (batch_count < 0)
+        return -17;
+    gemm_batch(ta, tb, m, n, k, alpha, lda, ldb, beta, ldc, batch_count,
+               [&](int i, const float *&a, const float *&b, float *&c) {
+                   a = A + i * stride_a;
+                   b = B + i * stride_b;
+                   c = C + i * stride_c;
+               });
+    return 0;
+}
@@ -0,0 +1,293 @@
+#include "gemm.h"
+
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+#include <omp.h>
+#include <immintrin.h>
+
+// Low-precision integer GEMM with int32 accumulation. Operands are packed in
+// groups of G consecutive k values (4 x u8 or 2 x s16 = one 32-bit lane), so
+// one broadcast of A and one vector of B feed a vpdpbusd/vpdpwssd (VNNI) or a
+// vpmaddubsw + vpmaddwd / vpmaddwd pair per lane.
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+const int IMR = 12;         // 12 x 2 zmm accumulators
+const int INR = 32;
+typedef __m512i ivec;
+#elif defined(__AVX2__)
+const int IMR = 6;          // 6 x 2 ymm accumulators
+const int INR = 16;
+typedef __m256i ivec;
+#else
+const int IMR = 4;
+const int INR = 8;
+#endif
+
+static void *aligned_bytes(size_t bytes) {
+    return std::aligned_alloc(64, (bytes + 63) / 64 * 64);
+}
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+static inline ivec vzero() { return _mm512_setzero_si512(); }
+static inline ivec vbcast(const void *p) { int32_t v; std::memcpy(&v, p, 4); return _mm512_set1_epi32(v); }
+static inline ivec vload(const void *p) { return _mm512_load_si512(p); }
+static inline ivec vloadu(const int32_t *p) { return _mm512_loadu_si512(p); }
+static inline void vstoreu(int32_t *p, ivec v) { _mm512_storeu_si512(p, v); }
+static inline ivec vadd(ivec a, ivec b) { return _mm512_add_epi32(a, b); }
+
+static inline ivec dot_u8s8(ivec acc, ivec a, ivec b) {
+#if defined(__AVX512VNNI__)
+    return _mm512_dpbusd_epi32(acc, a, b);
+#else
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(_mm512_maddubs_epi16(a, b), _mm512_set1_epi16(1)));
+#endif
+}
+
+static inline ivec dot_s16(ivec acc, ivec a, ivec b) {
+#if defined(__AVX512VNNI__)
+    return _mm512_dpwssd_epi32(acc, a, b);
+#else
+    return _mm512_add_epi32(acc, _mm512_madd_epi16(a, b));
+#endif
+}
+#elif defined(__AVX2__)
+static inline ivec vzero() { return _mm256_setzero_si256(); }
+static inline ivec vbcast(const void *p) { int32_t v; std::memcpy(&v, p, 4); return _mm256_set1_epi32(v); }
+static inline ivec vload(const void *p) { return _mm256_load_si256((const __m256i *)p); }
+static inline ivec vloadu(const int32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+static inline void vstoreu(int32_t *p, ivec v) { _mm256_storeu_si256((__m256i *)p, v); }
+static inline ivec vadd(ivec a, ivec b) { return _mm256_add_epi32(a, b); }
+
+static inline ivec dot_u8s8(ivec acc, ivec a, ivec b) {
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(a, b), _mm256_set1_epi16(1)));
+}
+
+static inline ivec dot_s16(ivec acc, ivec a, ivec b) {
+    return _mm256_add_epi32(acc, _mm256_madd_epi16(a, b));
+}
+#endif
+
+// Operand pairs: element types, k-group size and the per-lane dot product
+struct U8S8 {
+    typedef uint8_t TA;
+    typedef int8_t TB;
+    static const int G = 4;
+#if defined(__AVX2__)
+    static ivec dot(ivec acc, ivec a, ivec b) { return dot_u8s8(acc, a, b); }
+#endif
+};
+
+struct S16S16 {
+    typedef int16_t TA;
+    typedef int16_t TB;
+    static const int G = 2;
+#if defined(__AVX2__)
+    static ivec dot(ivec acc, ivec a, ivec b) { return dot_s16(acc, a, b); }
+#endif
+};
+
+// mc x kc block of A into IMR-row micro-panels laid out [k-group][row][G]
+template <typename Op>
+static void pack_A_int(const typename Op::TA *A, int lda, int i0, int k0, int mc, int kc,
+                       typename Op::TA *buf) {
+    const int G = Op::G;
+    for (int ir = 0; ir < mc; ir += IMR) {
+        int mr = std::min(IMR, mc - ir);
+        for (int p = 0; p < kc; p += G) {
+            int g_valid = std::min(G, kc - p);
+            for (int r = 0; r < IMR; ++r) {
+                for (int g = 0; g < G; ++g)
+                    buf[g] = 0;
+                if (r < mr) {
+                    const typename Op::TA *src = A + (size_t)(i0 + ir + r) * lda + k0 + p;
+                    for (int g = 0; g < g_valid; ++g)
+                        buf[g] = src[g];
+                }
+                buf += G;
+            }
+        }
+    }
+}
+
+// kc x nc panel of B into INR-column micro-panels laid out [k-group][column][G]
+template <typename Op>
+static void pack_B_int(const typename Op::TB *B, int ldb, int k0, int j0, int kc, int nc,
+                       typename Op::TB *buf) {
+    const int G = Op::G;
+    int kc_padded = (kc + G - 1) / G * G;
+    #pragma omp for schedule(static)
+    for (int jr = 0; jr < nc; jr += INR) {
+        int nr = std::min(INR, nc - jr);
+        typename Op::TB *dst = buf + (size_t)jr * kc_padded;
+        for (int p = 0; p < kc; p += G) {
+            for (int c = 0; c < INR; ++c)
+                for (int g = 0; g < G; ++g)
+                    dst[c * G + g] = c < nr && p + g < kc ? B[(size_t)(k0 + p + g) * ldb + j0 + jr + c] : 0;
+            dst += INR * G;
+        }
+    }
+}
+
+// C[IMR x INR] (+)= A_panel * B_panel over kg k-groups, C block in registers
+template <typename Op>
+static inline void int_micro_kernel(int kg, const typename Op::TA *a, const typename Op::TB *b,
+                                    int32_t *c, int ldc, bool accumulate) {
+    const int G = Op::G;
+#if defined(__AVX2__)
+    const int VEC = INR / 2;    // int32 columns per vector
+    ivec acc[IMR][2];
+    #pragma GCC unroll 12
+    for (int r = 0; r < IMR; ++r)
+        acc[r][0] = acc[r][1] = vzero();
+
+    for (int p = 0; p < kg; ++p) {
+        ivec b0 = vload(b);
+        ivec b1 = vload(b + VEC * G);
+        #pragma GCC unroll 12
+        for (int r = 0; r < IMR; ++r) {
+            ivec ar = vbcast(a + r * G);
+            acc[r][0] = Op::dot(acc[r][0], ar, b0);
+            acc[r][1] = Op::dot(acc[r][1], ar, b1);
+        }
+        a += IMR * G;
+        b += INR * G;
+    }
+
+    #pragma GCC unroll 12
+    for (int r = 0; r < IMR; ++r) {
+        int32_t *cr = c + (size_t)r * ldc;
+        if (accumulate) {
+            acc[r][0] = vadd(acc[r][0], vloadu(cr));
+            acc[r][1] = vadd(acc[r][1], vloadu(cr + VEC));
+        }
+        vstoreu(cr, acc[r][0]);
+        vstoreu(cr + VEC, acc[r][1]);
+    }
+#else
+    int32_t acc[IMR][INR] = {};
+    for (int p = 0; p < kg; ++p) {
+        for (int r = 0; r < IMR; ++r)
+            for (int j = 0; j < INR; ++j) {
+                int32_t sum = 0;
+                for (int g = 0; g < G; ++g)
+                    sum += (int32_t)a[r * G + g] * (int32_t)b[j * G + g];
+                acc[r][j] += sum;
+            }
+        a += IMR * G;
+        b += INR * G;
+    }
+    for (int r = 0; r < IMR; ++r)
+        for (int j = 0; j < INR; ++j)
+            c[(size_t)r * ldc + j] = accumulate ? c[(size_t)r * ldc + j] + acc[r][j] : acc[r][j];
+#endif
+}
+
+template <typename Op>
+static void int_block_kernel(int kg, const typename Op::TA *a, const typename Op::TB *b,
+                             int32_t *c, int ldc, int mr, int nr, bool accumulate) {
+    if (mr == IMR && nr == INR) {
+        int_micro_kernel<Op>(kg, a, b, c, ldc, accumulate);
+        return;
+    }
+    alignas(64) int32_t tmp[IMR * INR];
+    int_micro_kernel<Op>(kg, a, b, tmp, INR, false);
+    for (int r = 0; r < mr; ++r)
+        for (int j = 0; j < nr; ++j) {
+            int32_t *cj = c + (size_t)r * ldc + j;
+            *cj = accumulate ? *cj + tmp[r * INR + j] : tmp[r * INR + j];
+        }
+}
+
+// Same loop structure as the float engine. kc keeps the float engine's L1
+// budget in bytes, so 8-bit operands get a 4x deeper micro-panel.
+template <typename Op>
+static void gemm_int_packed(int m, int n, int k, const typename Op::TA *A, int lda,
+                            const typename Op::TB *B, int ldb, bool accumulate, int32_t *C, int ldc) {
+    const int G = Op::G;
+    const GemmConfig cfg = gemm_get_config();
+    const int kc_max = std::max(G, cfg.kc * (int)(sizeof(float) / sizeof(typename Op::TB)) / G * G);
+    const int mc_max = (cfg.mc + IMR - 1) / IMR * IMR;
+    const int nc_max = (cfg.nc + INR - 1) / INR * INR;
+
+    typename Op::TB *packed_B =
+        (typename Op::TB *)aligned_bytes((size_t)kc_max * nc_max * sizeof(typename Op::TB));
+
+    #pragma omp parallel
+    {
+        typename Op::TA *packed_A =
+            (typename Op::TA *)aligned_bytes((size_t)mc_max * kc_max * sizeof(typename Op::TA));
+
+        for (int jc = 0; jc < n; jc += nc_max) {
+            int nc = std::min(nc_max, n - jc);
+            for (int pc = 0; pc < k; pc += kc_max) {
+                int kc = std::min(kc_max, k - pc);
+                int kc_padded = (kc + G - 1) / G * G;
+                bool acc_pc = accumulate || pc > 0;
+
+                pack_B_int<Op>(B, ldb, pc, jc, kc, nc, packed_B);
+
+                #pragma omp for schedule(dynamic)
+                for (int ic = 0; ic < m; ic += mc_max) {
+                    int mc = std::min(mc_max, m - ic);
+                    pack_A_int<Op>(A, lda, ic, pc, mc, kc, packed_A);
+                    for (int jr = 0; jr < nc; jr += INR) {
+                        const typename Op::TB *b = packed_B + (size_t)jr * kc_padded;
+                        for (int ir = 0; ir < mc; ir += IMR)
+                            int_block_kernel<Op>(kc_padded / G, packed_A + (size_t)ir * kc_padded, b,
+                                                 C + (size_t)(ic + ir) * ldc + jc + jr, ldc,
+                                                 std::min(IMR, mc - ir), std::min(INR, nc - jr), acc_pc);
+                    }
+                }
+            }
+        }
+
+        std::free(packed_A);
+    }
+
+    std::free(packed_B);
+}
+
+static int check_int_args(int m, int n, int k, int lda, int ldb, int ldc) {
+    if (m < 0) return -1;
+    if (n < 0) return -2;
+    if (k < 0) return -3;
+    if (lda < std::max(1, k)) return -5;
+    if (ldb < std::max(1, n)) return -7;
+    if (ldc < std::max(1, n)) return -10;
+    return 0;
+}
+
+static void clear_C(int m, int n, int32_t *C, int ldc) {
+    for (int i = 0; i < m; ++i)
+        std::fill(C + (size_t)i * ldc, C + (size_t)i * ldc + n, 0);
+}
+
+int gemm_u8s8s32(int m, int n, int k, const uint8_t *A, int lda, const int8_t *B, int ldb,
+                 bool accumulate, int32_t *C, int ldc) {
+    int info = check_int_args(m, n, k, lda, ldb, ldc);
+    if (info != 0 || m == 0 || n == 0)
+        return info;
+    if (k == 0) {
+        if (!accumulate)
+            clear_C(m, n, C, ldc);
+        return 0;
+    }
+    gemm_int_packed<U8S8>(m, n, k, A, lda, B, ldb, accumulate, C, ldc);
+    return 0;
+}
+
+int gemm_s16s16s32(int m, int n, int k, const int16_t *A, int lda, const int16_t *B, int ldb,
+                   bool accumulate, int32_t *C, int ldc) {
+    int info = check_int_args(m, n, k, lda, ldb, ldc);
+    if (info != 0 || m == 0 || n == 0)
+        return info;
+    if (k == 0) {
+        if (!accumulate)
+            clear_C(m, n, C, ldc);
+        return 0;
+    }
+    gemm_int_packed<S16S16>(m, n, k, A, lda, B, ldb, accumulate, C, ldc);
+    return 0;
+}
@@ -0,0 +1,238 @@
+#include "kernels.h"
+#include "gemm.h"
+#include "thread_pool.h"
+#include "tiled_kernels.h"
+#include "strassen.h"
+#include "transpose.h"
+
+#include <vector>
+#include <thread>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <omp.h>
+
+// The loop nests below are the ones from the stand-alone programs, ported to
+// flat float storage and a runtime n so they can be timed side by side. The
+// tiled ones are instantiations of the shared templates in tiled_kernels.h.
+
+const int BLOCK_SIZE = 64;  // basic_mm.cpp, basic_mm1.cpp, matmul.cpp, matmul_op.cpp, tiled_mm.cpp
+const int TILE = 128;       // omp2.cpp, tiled_matrix_multiplication.cpp
+const int TILE_L1 = 64;     // tiled_mm_3tiles.cpp, tiled_mm_omp.cpp, tiled_mm_vect.cpp
+const int TILE_L2 = 128;
+const int TILE_L3 = 512;
+
+// Textbook triple loop, the baseline of the optimization story
+static void naive_multiply(const float *A, const float *B, float *C, int n, int) {
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j) {
+            float sum = C[i * n + j];
+            for (int k = 0; k < n; ++k)
+                sum += A[i * n + k] * B[k * n + j];
+            C[i * n + j] = sum;
+        }
+}
+
+// tiled_mm.cpp: single-threaded loop tiling
+static void tiled_multiply(const float *A, const float *B, float *C, int n, int) {
+    tiled_rows<float, BLOCK_SIZE>(TileOperands<float>{A, B, C, n, n, n, n, n, n}, 0, n);
+}
+
+// Spawns num_threads workers over static row bands, the last one taking the remainder
+template <typename Worker>
+static void run_row_bands(int n, int num_threads, Worker worker) {
+    std::vector<std::thread> threads;
+    int rows_per_thread = n / num_threads;
+    for (int t = 0; t < num_threads; ++t) {
+        int row_start = t * rows_per_thread;
+        int row_end = (t == num_threads - 1) ? n : row_start + rows_per_thread;
+        threads.emplace_back(worker, row_start, row_end);
+    }
+    for (auto &thread : threads)
+        thread.join();
+}
+
+// basic_mm.cpp: std::thread row bands with BLOCK_SIZE tiles
+static void pthread_blocked_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    TileOperands<float> ops{A, B, C, n, n, n, n, n, n};
+    run_row_bands(n, num_threads, [=](int row_start, int row_end) {
+        tiled_rows<float, BLOCK_SIZE>(ops, row_start, row_end);
+    });
+}
+
+// tiled_matrix_multiplication.cpp: std::thread row bands with one tile level
+static void pthread_tiled_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    TileOperands<float> ops{A, B, C, n, n, n, n, n, n};
+    run_row_bands(n, num_threads, [=](int row_start, int row_end) {
+        tiled_rows<float, TILE>(ops, row_start, row_end);
+    });
+}
+
+// tiled_mm_3tiles.cpp: std::thread row bands with three tile levels
+static void pthread_3level_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    TileOperands<float> ops{A, B, C, n, n, n, n, n, n};
+    run_row_bands(n, num_threads, [=](int row_start, int row_end) {
+        tiled_3level_rows<float, TILE_L1, TILE_L2, TILE_L3>(ops, row_start, row_end);
+    });
+}
+
+WorkStealingPool &kernel_pool(int num_threads) {
+    static std::unique_ptr<WorkStealingPool> pool;
+    if (!pool || pool->size() != num_threads)
+        pool.reset(new WorkStealingPool(num_threads));
+    return *pool;
+}
+
+// tiled_matrix_multiplication.cpp: TILE x TILE tiles of C on the work-stealing pool
+static void pthread_steal_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    TileOperands<float> ops{A, B, C, n, n, n, n, n, n};
+    int tiles = (n + TILE - 1) / TILE;
+    kernel_pool(num_threads).run_tiles(tiles, tiles, [=](int ti, int tj) {
+        tiled_c_tile<float, TILE>(ops, ti * TILE, tj * TILE, n);
+    });
+}
+
+// tiled_mm_3tiles.cpp: L3 tiles of C on the work-stealing pool
+static void pthread_3level_steal_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    TileOperands<float> ops{A, B, C, n, n, n, n, n, n};
+    int tiles = (n + TILE_L3 - 1) / TILE_L3;
+    kernel_pool(num_threads).run_tiles(tiles, tiles, [=](int ti, int tj) {
+        tiled_3level_c_tile<float, TILE_L1, TILE_L2, TILE_L3>(ops, ti * TILE_L3, tj * TILE_L3, n);
+    });
+}
+
+// omp2.cpp: OpenMP over one tile level
+static void omp_tiled_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    tiled_omp<float, TILE>(TileOperands<float>{A, B, C, n, n, n, n, n, n}, num_threads);
+}
+
+// tiled_mm_omp.cpp and tiled_mm_vect.cpp: OpenMP over L3 tiles, three tile
+// levels. The two programs differed only in the simd pragma on the dot
+// product; the shared nest vectorizes every instantiation.
+static void omp_3level_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    tiled_3level_omp<float, TILE_L1, TILE_L2, TILE_L3>(TileOperands<float>{A, B, C, n, n, n, n, n, n}, num_threads);
+}
+
+// tiled_mm_omp.cpp --strassen: Strassen-Winograd over the 3-level kernel. It
+// overwrites C, which matches C += A * B on the zeroed C the bench passes in.
+// The workspace block comes back from the matrix arena after the first rep.
+static void strassen_multiply_kernel(const float *A, const float *B, float *C, int n, int num_threads) {
+    StrassenWorkspace ws(STRASSEN_CROSSOVER, num_threads);
+    strassen_multiply(TileOperands<float>{A, B, C, n, n, n, n, n, n}, ws);
+}
+
+// basic_mm1.cpp and matmul_op.cpp: OpenMP over BLOCK_SIZE tiles
+static void omp_blocked_simd_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    tiled_omp<float, BLOCK_SIZE>(TileOperands<float>{A, B, C, n, n, n, n, n, n}, num_threads);
+}
+
+// matmul_op.cpp before the split-K work: as above with dynamic scheduling and
+// an atomic update per C element, kept as a reference point
+static void omp_atomic_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    #pragma omp parallel for collapse(2) schedule(dynamic) num_threads(num_threads)
+    for (int ii = 0; ii < n; ii += BLOCK_SIZE)
+        for (int jj = 0; jj < n; jj += BLOCK_SIZE)
+            for (int kk = 0; kk < n; kk += BLOCK_SIZE)
+                for (int i = ii; i < std::min(ii + BLOCK_SIZE, n); ++i)
+                    for (int j = jj; j < std::min(jj + BLOCK_SIZE, n); ++j) {
+                        float sum = 0.0f;
+                        #pragma omp simd reduction(+:sum)
+                        for (int k = kk; k < std::min(kk + BLOCK_SIZE, n); ++k)
+                            sum += A[i * n + k] * B[k * n + j];
+                        #pragma omp atomic
+                        C[i * n + j] += sum;
+                    }
+}
+
+// matmul.cpp: transpose B with the blocked SIMD transpose (transpose.h), then
+// tile over (ii, jj, kk). The transpose is part of the timed region.
+// Parallelized over (ii, jj) only: the original collapse(3) lets two threads
+// update the same C tile concurrently.
+static void omp_transposed_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    std::vector<float> B_T((size_t)n * n);
+    transpose(B, n, n, n, B_T.data(), n, num_threads);
+
+    #pragma omp parallel for collapse(2) schedule(dynamic) num_threads(num_threads)
+    for (int ii = 0; ii < n; ii += BLOCK_SIZE)
+        for (int jj = 0; jj < n; jj += BLOCK_SIZE)
+            for (int kk = 0; kk < n; kk += BLOCK_SIZE)
+                for (int i = ii; i < std::min(ii + BLOCK_SIZE, n); ++i)
+                    for (int k = kk; k < std::min(kk + BLOCK_SIZE, n); ++k) {
+                        float a = A[i * n + k];
+                        for (int j = jj; j < std::min(jj + BLOCK_SIZE, n); ++j)
+                            C[i * n + j] += a * B_T[j * n + k];
+                    }
+}
+
+// tiled_mm_packed.cpp: packed panels + register-blocked FMA microkernel, on
+// exactly num_threads threads rather than the team gemm_plan would pick
+static void packed_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    int saved = omp_get_max_threads();
+    omp_set_num_threads(num_threads);
+    gemm_set_thread_mode(GEMM_THREADS_EXACT);
+    sgemm('N', 'N', n, n, n, 1.0f, A, n, B, n, 1.0f, C, n);
+    gemm_set_thread_mode(GEMM_THREADS_PLANNED);
+    omp_set_num_threads(saved);
+}
+
+// Packed engine forced into split-K mode: private per-thread C, tree reduction
+static void packed_split_k_multiply(const float *A, const float *B, float *C, int n, int num_threads) {
+    gemm_set_split_k(SPLIT_K_ALWAYS);
+    packed_multiply(A, B, C, n, num_threads);
+    gemm_set_split_k(SPLIT_K_AUTO);
+}
+
+// Traffic models. The naive loop streams all of B once per row of C.
+static double naive_traffic(int n) {
+    return 4.0 * n * n * (double)n + 12.0 * n * (double)n;
+}
+
+// A T x T tile of C reads a T-row panel of A and a T-column panel of B over
+// all of k, and C is read and written once: 8 n^3 / T + 8 n^2 bytes, about
+// T / 4 FLOP per byte. For the three-level nests T is the L3 tile.
+template <int T>
+static double tile_traffic(int n) {
+    return 8.0 * n * n * (double)n / T + 8.0 * n * (double)n;
+}
+
+// Packed engine: A is packed once per nc-column panel of B, B once in all,
+// and C is read and written once per kc-deep block
+static double packed_traffic(int n) {
+    const GemmConfig cfg = gemm_get_config();
+    const double matrix = 4.0 * n * (double)n;
+    return matrix * ((n + cfg.nc - 1) / cfg.nc) + matrix + 2.0 * matrix * ((n + cfg.kc - 1) / cfg.kc);
+}
+
+const std::vector<Kernel> &kernel_registry() {
+    static const std::vector<Kernel> registry = {
+        {"naive",            "(stage 1)",                       false, naive_multiply, false, naive_traffic},
+        {"tiled",            "tiled_mm.cpp",                    false, tiled_multiply, false, tile_traffic<BLOCK_SIZE>},
+        {"pthread_blocked",  "basic_mm.cpp",                    true,  pthread_blocked_multiply, false,
+         tile_traffic<BLOCK_SIZE>},
+        {"pthread",          "tiled_matrix_multiplication.cpp", true,  pthread_tiled_multiply, false, tile_traffic<TILE>},
+        {"pthread_3level",   "tiled_mm_3tiles.cpp",             true,  pthread_3level_multiply, false,
+         tile_traffic<TILE_L3>},
+        {"pthread_steal",    "tiled_matrix_multiplication.cpp", true,  pthread_steal_multiply, true, tile_traffic<TILE>},
+        {"pthread_3level_steal", "tiled_mm_3tiles.cpp",         true,  pthread_3level_steal_multiply, true,
+         tile_traffic<TILE_L3>},
+        {"omp",              "omp2.cpp",                        true,  omp_tiled_multiply, false, tile_traffic<TILE>},
+        {"omp_3level",       "tiled_mm_omp.cpp",                true,  omp_3level_multiply, false, tile_traffic<TILE_L3>},
+        {"omp_simd",         "tiled_mm_vect.cpp",               true,  omp_3level_multiply, false, tile_traffic<TILE_L3>},
+        {"strassen",         "tiled_mm_omp.cpp",                true,  strassen_multiply_kernel},
+        {"omp_blocked_simd", "basic_mm1.cpp",                   true,  omp_blocked_simd_multiply, false,
+         tile_traffic<BLOCK_SIZE>},
+        {"omp_atomic",       "matmul_op.cpp",                   true,  omp_atomic_multiply, false, tile_traffic<BLOCK_SIZE>},
+        {"omp_transposed",   "matmul.cpp",                      true,  omp_transposed_multiply, false,
+         tile_traffic<BLOCK_SIZE>},
+        {"packed",           "tiled_mm_packed.cpp",             true,  packed_multiply, false, packed_traffic},
+        {"packed_split_k",   "tiled_mm_packed.cpp",             true,  packed_split_k_multiply, false, packed_traffic},
+    };
+    return registry;
+}
+
+const Kernel *find_kernel(const char *name) {
+    for (const Kernel &k : kernel_registry())
+        if (std::strcmp(k.name, name) == 0)
+            return &k;
+    return nullptr;
+}
@@ -0,0 +1,36 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <vector>
+
+// Common interface for every matrix multiplication variant in the repo.
+// Each kernel computes C += A * B for square n x n row-major float matrices;
+// num_threads is the team size for the parallel variants (ignored by serial ones).
+using KernelFn = void (*)(const float *A, const float *B, float *C, int n, int num_threads);
+
+// Memory traffic in bytes of one call at size n, modelled from the kernel's
+// blocking: what it moves when the cache holds its working tiles and nothing
+// else. Gives the arithmetic intensity for the bench's roofline mode.
+using KernelTrafficFn = double (*)(int n);
+
+struct Kernel {
+    const char *name;
+    const char *source;   // program the loop nest was taken from
+    bool parallel;        // false: only meaningful at one thread
+    KernelFn fn;
+    bool pooled = false;  // runs on kernel_pool() rather than OpenMP or fresh threads
+    KernelTrafficFn traffic = nullptr;  // nullptr: no simple model (Strassen)
+};
+
+// All registered variants, from the naive triple loop to the packed engine
+const std::vector<Kernel> &kernel_registry();
+
+// Persistent work-stealing pool behind the *_steal variants, rebuilt only when
+// the requested thread count changes
+class WorkStealingPool;
+WorkStealingPool &kernel_pool(int num_threads);
+
+// Looks a kernel up by name; nullptr when unknown
+const Kernel *find_kernel(const char *name);
+
+#endif
@@ -1,77 +1,91 @@
 #include <iostream>
 #include <omp.h>
-#include <vector>
-#include <random>
 #include <algorithm>
 #include <chrono>
+#include "perf_counters.h"
+#include "autotune.h"
+#include "matrix.h"
+#include "rng.h"
+#include "transpose.h"
+#include "team_plan.h"
 
 #define N 2048         // Matrix dimension
-//#define BLOCK_SIZE 128 // Loop tiling block size
-#define BLOCK_SIZE 64
 
-// Thread-safe random number initialization
-void initializeMatrix(std::vector<float>& mat, int size) {
-	#pragma omp parallel
-	{
-		std::mt19937 rng;
-		rng.seed(std::random_device{}() + omp_get_thread_num());
-		std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+// Loop tiling block size: ./tune's one-level tile edge for this CPU, else 64
+const int block_size = tuned_tile_config().tile;
 
-		#pragma omp for
-		for (int i = 0; i < size; ++i) {
-			mat[i] = dist(rng);
-		}
-	}
+// Parallel random initialization: element (i, j) depends only on (seed, i, j),
+// so every run and thread count sees the same matrix
+void initializeMatrix(DenseMatrix<float>& mat, uint64_t seed) {
+	philox_fill_uniform(mat, seed, 0.0f, 1.0f);
 }
 
-// Transpose matrix B to improve cache performance
-void transposeMatrix(const std::vector<float>& src, std::vector<float>& dst, int n) {
-	#pragma omp parallel for collapse(2) schedule(dynamic)
-	//#pragma omp parallel for collapse(2) schedule(static)
-	for (int i = 0; i < n; ++i) {
-		for (int j = 0; j < n; ++j) {
-			dst[j * n + i] = src[i * n + j];
-		}
-	}
+// Transpose matrix B to improve cache performance: blocked, register-level
+// SIMD transpose with streaming stores (transpose.h)
+void transposeMatrix(const DenseMatrix<float>& src, DenseMatrix<float>& dst) {
+	transpose(src, dst);
 }
 
-// Optimized matrix multiplication using tiling, transposed B, and OpenMP
-void multiplyMatrices(const std::vector<float>& A, const std::vector<float>& B_T, std::vector<float>& C, int n) {
-	#pragma omp parallel for collapse(3) schedule(dynamic)
-	//#pragma omp parallel for collapse(2) schedule(static, 2)
-	for (int ii = 0; ii < n; ii += BLOCK_SIZE) {
-		for (int jj = 0; jj < n; jj += BLOCK_SIZE) {
-			for (int kk = 0; kk < n; kk += BLOCK_SIZE) {
-				for (int i = ii; i < std::min(ii + BLOCK_SIZE, n); ++i) {
-					for (int k = kk; k < std::min(kk + BLOCK_SIZE, n); ++k) {
-						float a = A[i * n + k];
-						for (int j = jj; j < std::min(jj + BLOCK_SIZE, n); ++j) {
-							C[i * n + j] += a * B_T[j * n + k]; // Access B_T row-wise
-						}
-					}
+// The C tile at (ii, jj) over all of k
+void multiplyTile(const DenseMatrix<float>& A, const DenseMatrix<float>& B_T, DenseMatrix<float>& C, int ii, int jj,
+                  int n) {
+	for (int kk = 0; kk < n; kk += block_size) {
+		for (int i = ii; i < std::min(ii + block_size, C.rows()); ++i) {
+			for (int k = kk; k < std::min(kk + block_size, n); ++k) {
+				float a = A(i, k);
+				for (int j = jj; j < std::min(jj + block_size, C.cols()); ++j) {
+					C(i, j) += a * B_T(j, k); // Access B_T row-wise
 				}
 			}
 		}
 	}
 }
 
+// Optimized matrix multiplication using tiling, transposed B, and OpenMP.
+// Only (ii, jj) is collapsed: with kk in the parallel space two threads would
+// update the same C tile concurrently. The schedule is set in main.
+void multiplyMatrices(const DenseMatrix<float>& A, const DenseMatrix<float>& B_T, DenseMatrix<float>& C, int n) {
+	#pragma omp parallel for collapse(2) schedule(runtime)
+	for (int ii = 0; ii < n; ii += block_size) {
+		for (int jj = 0; jj < n; jj += block_size) {
+			multiplyTile(A, B_T, C, ii, jj, n);
+		}
+	}
+}
+
+// Seconds of one C tile on scratch operands shaped like it, for plan_team
+double tileSeconds() {
+	DenseMatrix<float> a(block_size, N, 1.0f), b_t(block_size, N, 2.0f), c(block_size, block_size, 0.0f);
+	return time_best([&] { multiplyTile(a, b_t, c, 0, 0, N); });
+}
+
 int main() {
-	std::vector<float> A(N * N), B(N * N), B_T(N * N), C(N * N, 0.0f);
+	DenseMatrix<float> A(N, N), B(N, N), B_T(N, N), C(N, N, 0.0f);
 
-	initializeMatrix(A, N * N);
-	initializeMatrix(B, N * N);
+	initializeMatrix(A, 1);
+	initializeMatrix(B, 2);
 
 	// Transpose B for better access during multiplication
-	transposeMatrix(B, B_T, N);
+	transposeMatrix(B, B_T);
 
-	int num_threads = 4;  // For 4-core CPU
+	// Team size from this loop's own measured tile time rather than a fixed
+	// core count; static when the tiles split evenly over the team
+	int tiles = (N + block_size - 1) / block_size;
+	int num_threads = plan_team(tiles * tiles, tileSeconds(), omp_get_max_threads()).num_threads;
+	bool even = N % block_size == 0 && tiles * tiles % num_threads == 0;
 	omp_set_num_threads(num_threads);
-	std::cout << "Running with " << num_threads << " threads.\n";
+	omp_set_schedule(even ? omp_sched_static : omp_sched_dynamic, 0);
+	std::cout << "Running with " << num_threads << " threads, " << (even ? "static" : "dynamic") << " schedule, "
+	          << block_size << " blocks.\n";
 
+	PerfCounters counters;
+	counters.start();
 	double start = omp_get_wtime();
 	multiplyMatrices(A, B_T, C, N);
 	double end = omp_get_wtime();
+	counters.stop();
 
 	std::cout << "Multiplication completed in " << (end - start) << " seconds.\n";
+	counters.report(std::cout, 2.0 * N * N * N, true);
 	return 0;
 }
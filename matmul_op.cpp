@@ -1,82 +1,50 @@
 #include <iostream>
-#include <cstdlib>      // For rand(), malloc(), free()
-#include <ctime>        // For seeding rand()
 #include <omp.h>        // OpenMP
+#include "perf_counters.h"
+#include "tiled_kernels.h"
+#include "matrix.h"
+#include "rng.h"
 
 #define M 2048
 #define N 2048
 #define K 2048
-#define BLOCK_SIZE 64
 
-#define fast_min(a, b) ((a) < (b) ? (a) : (b))
-
-// Initialize matrix with random values or zeros
-void initializeMatrix(float* mat, int size, bool zero = false) {
-	#pragma omp parallel for
-	for (int i = 0; i < size; ++i)
-		mat[i] = zero ? 0.0f : std::rand() % 10;
-}
-
-// Matrix multiplication using 3-level parallel blocking
-void multiplyMatrices(const float* A, const float* B, float* C) {
-	// First block of parallel loops: blockwise iteration
-	#pragma omp parallel for collapse(2) schedule(dynamic)
-	for (int ii = 0; ii < M; ii += BLOCK_SIZE) {
-		for (int jj = 0; jj < N; jj += BLOCK_SIZE) {
-			for (int kk = 0; kk < K; kk += BLOCK_SIZE) {
-
-				// Second block: iterate over rows and cols within block
-				for (int i = ii; i < fast_min(ii + BLOCK_SIZE, M); ++i) {
-					for (int j = jj; j < fast_min(jj + BLOCK_SIZE, N); ++j) {
-						float sum = 0.0f;
-
-						// Third block: inner product within tile
-						#pragma omp simd reduction(+:sum)
-						for (int k = kk; k < fast_min(kk + BLOCK_SIZE, K); ++k) {
-							sum += A[i * K + k] * B[k * N + j];
-						}
-
-						// Accumulate safely (required when C[i*N+j] updated by multiple threads)
-						#pragma omp atomic
-						C[i * N + j] += sum;
-					}
-				}
-			}
-		}
-	}
+// Initialize matrix with random values (reproducible for any thread count) or zeros
+void initializeMatrix(DenseMatrix<float>& mat, uint64_t seed, bool zero = false) {
+	if (zero)
+		mat.fill(0.0f);
+	else
+		philox_fill_int(mat, seed, 0, 9);
 }
 
-// Free allocated matrices
-void cleanup(float* A, float* B, float* C) {
-	std::free(A);
-	std::free(B);
-	std::free(C);
+// Matrix multiplication over tiles of C with a dynamic OpenMP schedule; the
+// SIMD width and tile size are picked for the CPU at startup (GEMM_ISA
+// overrides). Each tile belongs to one thread, so no atomic is needed
+void multiplyMatrices(const DenseMatrix<float>& A, const DenseMatrix<float>& B, DenseMatrix<float>& C) {
+	TileOperands<float> ops{A.data(), B.data(), C.data(), M, N, K, A.ld(), B.ld(), C.ld()};
+	tiled_omp_dispatch(ops, omp_get_max_threads());
 }
 
 // Main driver
 int main() {
-	std::srand(static_cast<unsigned>(std::time(0)));
-
-	float* A = (float*) std::malloc(sizeof(float) * M * K);
-	float* B = (float*) std::malloc(sizeof(float) * K * N);
-	float* C = (float*) std::malloc(sizeof(float) * M * N);
-
-	if (!A || !B || !C) {
-		std::cerr << "Memory allocation failed!" << std::endl;
-		return -1;
-	}
+	DenseMatrix<float> A(M, K);
+	DenseMatrix<float> B(K, N);
+	DenseMatrix<float> C(M, N);
 
-	initializeMatrix(A, M * K);
-	initializeMatrix(B, K * N);
-	initializeMatrix(C, M * N, true);  // zero initialize C
+	initializeMatrix(A, 1);
+	initializeMatrix(B, 2);
+	initializeMatrix(C, 0, true);  // zero initialize C
 
+	PerfCounters counters;
+	counters.start();
 	double start_time = omp_get_wtime();
 	multiplyMatrices(A, B, C);
 	double end_time = omp_get_wtime();
+	counters.stop();
 
 	std::cout << "Matrix multiplication completed in " 
-	          << (end_time - start_time) << " seconds.\n";
+	          << (end_time - start_time) << " seconds (" << isa_name(selected_isa()) << ").\n";
+	counters.report(std::cout, 2.0 * M * N * K, true);
 
-	cleanup(A, B, C);
 	return 0;
 }
@@ -0,0 +1,233 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+// Contiguous matrix storage shared by the programs and the bench:
+//
+//     DenseMatrix<float> A(N, N);          // contents unspecified until written
+//     DenseMatrix<float> C(N, N, 0.0f);    // filled
+//     A(i, j) = A.row(i)[j] = A.data()[i * A.ld() + j];
+//
+// One 64-byte-aligned buffer per matrix. Rows are padded to a whole number
+// of cache lines, plus one more line when a row would be a multiple of
+// 4 KB, so column walks at N = 4096 do not map every row to the same L1/L2
+// sets. Buffers come from a process-wide arena of mmap'd, 2 MB-aligned
+// blocks backed by huge pages. A released block is reused by the next
+// matrix that fits, so repeated multiplies do not go back to the kernel.
+// Fresh blocks are untouched, so first-touch placement still works (numa.h).
+//
+//     MM_HUGEPAGES=thp (default)   madvise(MADV_HUGEPAGE), transparent huge pages
+//     MM_HUGEPAGES=explicit        MAP_HUGETLB from the hugetlbfs pool, THP if it is empty
+//     MM_HUGEPAGES=off             4 KB pages
+
+#include <vector>
+#include <mutex>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <sys/mman.h>
+
+enum HugePageMode {
+    HUGEPAGES_OFF,
+    HUGEPAGES_THP,
+    HUGEPAGES_EXPLICIT
+};
+
+inline HugePageMode huge_page_mode_from_env() {
+    const char *mode = std::getenv("MM_HUGEPAGES");
+    if (!mode) return HUGEPAGES_THP;
+    std::string m = mode;
+    if (m == "off" || m == "0") return HUGEPAGES_OFF;
+    if (m == "explicit" || m == "hugetlb") return HUGEPAGES_EXPLICIT;
+    return HUGEPAGES_THP;
+}
+
+class MatrixArena {
+public:
+    static const size_t HUGE_PAGE = 2 << 20;
+
+    MatrixArena() : mode_(huge_page_mode_from_env()) {}
+
+    MatrixArena(const MatrixArena &) = delete;
+    MatrixArena &operator=(const MatrixArena &) = delete;
+
+    ~MatrixArena() {
+        for (const Block &b : blocks_)
+            munmap(b.ptr, b.bytes);
+    }
+
+    // Smallest free block that holds bytes without wasting more than half
+    // of it, else a new mapping. nullptr when the system is out of memory.
+    void *acquire(size_t bytes) {
+        bytes = (std::max(bytes, (size_t)1) + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        std::lock_guard<std::mutex> lock(mutex_);
+        Block *best = nullptr;
+        for (Block &b : blocks_)
+            if (!b.in_use && b.bytes >= bytes && b.bytes / 2 < bytes && (!best || b.bytes < best->bytes))
+                best = &b;
+        if (best) {
+            best->in_use = true;
+            ++reuses_;
+            return best->ptr;
+        }
+        bool hugetlb = false;
+        void *p = map(bytes, hugetlb);
+        if (!p)
+            return nullptr;
+        blocks_.push_back(Block{p, bytes, true, hugetlb});
+        mapped_ += bytes;
+        return p;
+    }
+
+    void release(void *p) {
+        if (!p)
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Block &b : blocks_)
+            if (b.ptr == p)
+                b.in_use = false;
+    }
+
+    // Unmaps every block that is not in use
+    void trim() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto keep = std::remove_if(blocks_.begin(), blocks_.end(), [&](const Block &b) {
+            if (b.in_use)
+                return false;
+            munmap(b.ptr, b.bytes);
+            mapped_ -= b.bytes;
+            return true;
+        });
+        blocks_.erase(keep, blocks_.end());
+    }
+
+    size_t mapped_bytes() const { return mapped_; }
+    size_t reuses() const { return reuses_; }
+    HugePageMode mode() const { return mode_; }
+
+private:
+    struct Block {
+        void *ptr;
+        size_t bytes;
+        bool in_use;
+        bool hugetlb;
+    };
+
+    void *map(size_t bytes, bool &hugetlb) {
+#ifdef MAP_HUGETLB
+        if (mode_ == HUGEPAGES_EXPLICIT) {
+            void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                hugetlb = true;
+                return p;
+            }
+        }
+#endif
+        // Over-map by one huge page and trim both ends to get a 2 MB-aligned block
+        size_t span = bytes + HUGE_PAGE;
+        void *raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+            return nullptr;
+        uintptr_t start = ((uintptr_t)raw + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+        if (start > (uintptr_t)raw)
+            munmap(raw, start - (uintptr_t)raw);
+        uintptr_t end = (uintptr_t)raw + span;
+        if (end > start + bytes)
+            munmap((void *)(start + bytes), end - (start + bytes));
+#ifdef MADV_HUGEPAGE
+        if (mode_ == HUGEPAGES_THP || mode_ == HUGEPAGES_EXPLICIT)
+            madvise((void *)start, bytes, MADV_HUGEPAGE);
+#endif
+        return (void *)start;
+    }
+
+    HugePageMode mode_;
+    std::mutex mutex_;
+    std::vector<Block> blocks_;
+    size_t mapped_ = 0;
+    size_t reuses_ = 0;
+};
+
+inline MatrixArena &matrix_arena() {
+    static MatrixArena arena;
+    return arena;
+}
+
+template <typename T>
+class DenseMatrix {
+public:
+    DenseMatrix() = default;
+
+    // pad = false keeps ld == cols for callers that assume a packed stride
+    DenseMatrix(int rows, int cols, bool pad = true)
+        : rows_(rows), cols_(cols), ld_(pad ? padded_ld(cols) : cols) {
+        data_ = static_cast<T *>(matrix_arena().acquire(size() * sizeof(T)));
+        if (!data_)
+            throw std::bad_alloc();
+    }
+
+    DenseMatrix(int rows, int cols, T value, bool pad = true) : DenseMatrix(rows, cols, pad) {
+        fill(value);
+    }
+
+    DenseMatrix(const DenseMatrix &) = delete;
+    DenseMatrix &operator=(const DenseMatrix &) = delete;
+
+    DenseMatrix(DenseMatrix &&other) noexcept { swap(other); }
+
+    DenseMatrix &operator=(DenseMatrix &&other) noexcept {
+        DenseMatrix tmp(std::move(other));
+        swap(tmp);
+        return *this;
+    }
+
+    ~DenseMatrix() { matrix_arena().release(data_); }
+
+    // Row stride in elements: whole cache lines, never a multiple of 4 KB
+    static int padded_ld(int cols) {
+        const int line = 64 / sizeof(T) > 0 ? 64 / sizeof(T) : 1;
+        int ld = (cols + line - 1) / line * line;
+        if (ld > 0 && (ld * sizeof(T)) % 4096 == 0)
+            ld += line;
+        return ld;
+    }
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int ld() const { return ld_; }
+
+    // Elements in the buffer, padding included
+    size_t size() const { return (size_t)rows_ * ld_; }
+
+    T *data() { return data_; }
+    const T *data() const { return data_; }
+    T *row(int i) { return data_ + (size_t)i * ld_; }
+    const T *row(int i) const { return data_ + (size_t)i * ld_; }
+    T &operator()(int i, int j) { return data_[(size_t)i * ld_ + j]; }
+    const T &operator()(int i, int j) const { return data_[(size_t)i * ld_ + j]; }
+
+    // Fills the rows x cols part; the padding is left alone
+    void fill(T value) {
+        for (int i = 0; i < rows_; ++i)
+            std::fill(row(i), row(i) + cols_, value);
+    }
+
+private:
+    void swap(DenseMatrix &other) noexcept {
+        std::swap(rows_, other.rows_);
+        std::swap(cols_, other.cols_);
+        std::swap(ld_, other.ld_);
+        std::swap(data_, other.data_);
+    }
+
+    int rows_ = 0;
+    int cols_ = 0;
+    int ld_ = 0;
+    T *data_ = nullptr;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef MATRIX_CHAIN_H
+#define MATRIX_CHAIN_H
+
+// Product of a chain of matrices with different shapes, A0 * A1 * ... * An-1:
+//
+//     ChainWorkspace ws;                             // reusable across calls
+//     chain_multiply({&A, &B, &C, &D}, result, ws);  // result = A * B * C * D
+//     ChainPlan plan = chain_plan(dims);             // or just inspect the order
+//
+// The parenthesization is the FLOP-minimal one, found by the classic O(n^3)
+// dynamic program over the dimensions; a bad order can cost 10x the work.
+// Every intermediate gets a slot in one workspace buffer, reserved once and
+// kept for later calls. Each product is split into row panels, and every
+// panel is an OpenMP task running a single-threaded sgemm. A panel waits only
+// for the same rows of its left factor and for the whole right factor, so
+// independent sub-products run side by side and a left-deep chain pipelines
+// panel by panel instead of waiting at a barrier after each product.
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cstddef>
+#include <omp.h>
+#include "matrix.h"
+#include "gemm.h"
+
+// Bounds of a product's row panel; the panel count aims at two per thread
+const int CHAIN_MIN_PANEL = 32;
+const int CHAIN_MAX_PANEL = 256;
+
+struct ChainPlan {
+    int count = 0;                      // matrices in the chain
+    std::vector<int> dims;              // matrix t is dims[t] x dims[t + 1]
+    std::vector<int> split;             // product (i..j) = (i..s) * (s+1..j) with s = split[i * count + j]
+    double flops = 0.0;                 // of the chosen order
+    double left_to_right_flops = 0.0;   // of ((A0 A1) A2) ...
+
+    int split_at(int i, int j) const { return split[(size_t)i * count + j]; }
+};
+
+inline ChainPlan chain_plan(const std::vector<int> &dims) {
+    if (dims.size() < 2)
+        throw std::invalid_argument("chain_plan: need at least one matrix");
+    ChainPlan plan;
+    plan.count = (int)dims.size() - 1;
+    plan.dims = dims;
+    const int n = plan.count;
+    std::vector<double> cost((size_t)n * n, 0.0);
+    plan.split.assign((size_t)n * n, 0);
+    for (int len = 2; len <= n; ++len)
+        for (int i = 0; i + len - 1 < n; ++i) {
+            const int j = i + len - 1;
+            double best = -1.0;
+            for (int s = i; s < j; ++s) {
+                double c = cost[(size_t)i * n + s] + cost[(size_t)(s + 1) * n + j] +
+                           2.0 * dims[i] * dims[s + 1] * (double)dims[j + 1];
+                if (best < 0.0 || c <= best) {     // ties go to the later split: left-deep pipelines
+                    best = c;
+                    plan.split[(size_t)i * n + j] = s;
+                }
+            }
+            cost[(size_t)i * n + j] = best;
+        }
+    plan.flops = cost[n - 1];
+    for (int t = 1; t < n; ++t)
+        plan.left_to_right_flops += 2.0 * dims[0] * dims[t] * (double)dims[t + 1];
+    return plan;
+}
+
+// The chosen order as text, e.g. "((A0 A1) (A2 A3))"
+inline std::string chain_order(const ChainPlan &plan, int i = 0, int j = -1) {
+    if (j < 0)
+        j = plan.count - 1;
+    if (i == j)
+        return "A" + std::to_string(i);
+    const int s = plan.split_at(i, j);
+    return "(" + chain_order(plan, i, s) + " " + chain_order(plan, s + 1, j) + ")";
+}
+
+inline int chain_panel_rows(int rows, int num_threads) {
+    int panel = (rows + 2 * num_threads - 1) / (2 * num_threads);
+    panel = (panel + 15) / 16 * 16;
+    return std::min(CHAIN_MAX_PANEL, std::max(CHAIN_MIN_PANEL, panel));
+}
+
+// One buffer for every intermediate of a plan; reserve only grows it
+class ChainWorkspace {
+public:
+    ChainWorkspace() = default;
+    ChainWorkspace(const ChainWorkspace &) = delete;
+    ChainWorkspace &operator=(const ChainWorkspace &) = delete;
+
+    ~ChainWorkspace() { matrix_arena().release(data_); }
+
+    // Lays out a slot per intermediate (every product but the last) and
+    // grows the buffer to fit them
+    void reserve(const ChainPlan &plan) {
+        count_ = plan.count;
+        offset_.assign((size_t)count_ * count_, 0);
+        size_t need = 0;
+        layout(plan, 0, count_ - 1, need, true);
+        if (need <= capacity_)
+            return;
+        matrix_arena().release(data_);
+        data_ = static_cast<float *>(matrix_arena().acquire(need * sizeof(float)));
+        if (!data_)
+            throw std::bad_alloc();
+        capacity_ = need;
+    }
+
+    // Slot of product (i..j) after reserve
+    float *slot(int i, int j) const { return data_ + offset_[(size_t)i * count_ + j]; }
+
+    // Row stride of an intermediate: whole cache lines
+    static int ld(int cols) { return (cols + 15) / 16 * 16; }
+
+    size_t bytes() const { return capacity_ * sizeof(float); }
+
+private:
+    void layout(const ChainPlan &plan, int i, int j, size_t &next, bool root) {
+        if (i == j)
+            return;
+        const int s = plan.split_at(i, j);
+        layout(plan, i, s, next, false);
+        layout(plan, s + 1, j, next, false);
+        if (!root) {
+            offset_[(size_t)i * count_ + j] = next;
+            next += (size_t)plan.dims[i] * ld(plan.dims[j + 1]);
+        }
+    }
+
+    int count_ = 0;
+    std::vector<size_t> offset_;
+    float *data_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+namespace chain_detail {
+
+struct Operand {
+    const float *data;
+    int ld;
+};
+
+// Task graph of a plan: one dependence token per row panel of every product
+struct Graph {
+    const ChainPlan &plan;
+    const std::vector<const DenseMatrix<float> *> &mats;
+    ChainWorkspace &ws;
+    DenseMatrix<float> &result;
+    int num_threads;
+    std::vector<char> tokens;
+    std::vector<size_t> first_token;    // per product (i..j)
+    char none = 0;                      // never written: a dependence on it is no dependence
+
+    size_t index(int i, int j) const { return (size_t)i * plan.count + j; }
+
+    int panel_rows(int i) const { return chain_panel_rows(plan.dims[i], num_threads); }
+    int panels(int i) const { return (plan.dims[i] + panel_rows(i) - 1) / panel_rows(i); }
+
+    void count_tokens(int i, int j, size_t &total) {
+        if (i == j)
+            return;
+        const int s = plan.split_at(i, j);
+        count_tokens(i, s, total);
+        count_tokens(s + 1, j, total);
+        first_token[index(i, j)] = total;
+        total += panels(i);
+    }
+
+    Operand operand(int i, int j) const {
+        if (i == j)
+            return Operand{mats[i]->data(), mats[i]->ld()};
+        return Operand{ws.slot(i, j), ChainWorkspace::ld(plan.dims[j + 1])};
+    }
+
+    // Creates the tasks of product (i..j) after those of its factors
+    void emit(int i, int j, bool root) {
+        if (i == j)
+            return;
+        const int s = plan.split_at(i, j);
+        emit(i, s, false);
+        emit(s + 1, j, false);
+
+        const int m = plan.dims[i], k = plan.dims[s + 1], n = plan.dims[j + 1];
+        const Operand L = operand(i, s), R = operand(s + 1, j);
+        float *P = root ? result.data() : ws.slot(i, j);
+        const int ldp = root ? result.ld() : ChainWorkspace::ld(n);
+        const int rows = panel_rows(i);
+        char *out = &tokens[first_token[index(i, j)]];
+        char *r_deps = s + 1 == j ? &none : &tokens[first_token[index(s + 1, j)]];
+        const int r_count = s + 1 == j ? 1 : panels(s + 1);
+
+        for (int r = 0; r < panels(i); ++r) {
+            char *l_dep = i == s ? &none : &tokens[first_token[index(i, s)] + r];
+            const int row0 = r * rows, mr = std::min(rows, m - row0);
+            (void)l_dep, (void)r_deps, (void)out;   // only named in depend clauses, which GCC 12 does not count
+            #pragma omp task firstprivate(row0, mr) depend(in: l_dep[0]) \
+                depend(iterator(t = 0 : r_count), in: r_deps[t]) depend(out: out[r])
+            {
+                omp_set_num_threads(1);     // this task's ICV: sgemm stays on this thread
+                sgemm('N', 'N', mr, n, k, 1.0f, L.data + (size_t)row0 * L.ld, L.ld, R.data, R.ld, 0.0f,
+                      P + (size_t)row0 * ldp, ldp);
+            }
+        }
+    }
+};
+
+}  // namespace chain_detail
+
+// result = mats[0] * mats[1] * ... in the FLOP-minimal order. Throws
+// std::invalid_argument when neighbouring shapes or the result shape do not match.
+inline ChainPlan chain_multiply(const std::vector<const DenseMatrix<float> *> &mats, DenseMatrix<float> &result,
+                                ChainWorkspace &ws, int num_threads = omp_get_max_threads()) {
+    if (mats.empty())
+        throw std::invalid_argument("chain_multiply: empty chain");
+    std::vector<int> dims{mats[0]->rows()};
+    for (size_t t = 0; t < mats.size(); ++t) {
+        if (mats[t]->rows() != dims.back())
+            throw std::invalid_argument("chain_multiply: matrix " + std::to_string(t) + " has " +
+                                        std::to_string(mats[t]->rows()) + " rows, expected " +
+                                        std::to_string(dims.back()));
+        dims.push_back(mats[t]->cols());
+    }
+    if (result.rows() != dims.front() || result.cols() != dims.back())
+        throw std::invalid_argument("chain_multiply: result must be " + std::to_string(dims.front()) + " x " +
+                                    std::to_string(dims.back()));
+
+    ChainPlan plan = chain_plan(dims);
+    if (plan.count == 1) {
+        for (int i = 0; i < result.rows(); ++i)
+            std::copy(mats[0]->row(i), mats[0]->row(i) + result.cols(), result.row(i));
+        return plan;
+    }
+    ws.reserve(plan);
+
+    chain_detail::Graph g{plan, mats, ws, result, std::max(1, num_threads), {}, {}};
+    g.first_token.assign((size_t)plan.count * plan.count, 0);
+    size_t total = 0;
+    g.count_tokens(0, plan.count - 1, total);
+    g.tokens.assign(total, 0);
+
+    #pragma omp parallel num_threads(g.num_threads)
+    #pragma omp single
+    g.emit(0, plan.count - 1, true);
+    return plan;
+}
+
+#endif
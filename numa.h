@@ -0,0 +1,253 @@
+#ifndef NUMA_H
+#define NUMA_H
+
+// NUMA placement for the OpenMP and thread-pool programs without linking
+// libnuma: the node -> CPU map comes from sysfs, threads are pinned with
+// sched_setaffinity, and pages land on a node by first touch.
+//
+//     MM_PIN=compact|scatter|socket   enable NUMA mode with that pinning policy
+//     MM_REPLICATE_B=1                also keep one copy of B per node
+//
+// In NUMA mode a program allocates its matrices untouched (DenseMatrix, matrix.h),
+// pins its team, initializes every tile from the thread that will compute it
+// (same static tile-to-thread mapping as the compute loop) and reads B from
+// its node's replica, so no thread streams A, B or C across the interconnect.
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <memory>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <sched.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+enum PinPolicy {
+    PIN_NONE,
+    PIN_COMPACT,    // fill node 0's CPUs, then node 1's, ...
+    PIN_SCATTER,    // round-robin threads across nodes
+    PIN_SOCKET      // contiguous thread blocks per node, free to move within it
+};
+
+struct NumaOptions {
+    PinPolicy pin = PIN_NONE;
+    bool replicate_b = false;
+
+    bool enabled() const { return pin != PIN_NONE; }
+};
+
+inline bool parse_pin_policy(const std::string &name, PinPolicy &policy) {
+    if (name == "none") policy = PIN_NONE;
+    else if (name == "compact") policy = PIN_COMPACT;
+    else if (name == "scatter") policy = PIN_SCATTER;
+    else if (name == "socket") policy = PIN_SOCKET;
+    else return false;
+    return true;
+}
+
+inline const char *pin_policy_name(PinPolicy policy) {
+    static const char *const names[] = {"none", "compact", "scatter", "socket"};
+    return names[policy];
+}
+
+inline NumaOptions numa_options_from_env() {
+    NumaOptions opt;
+    if (const char *pin = std::getenv("MM_PIN"))
+        parse_pin_policy(pin, opt.pin);
+    if (const char *rep = std::getenv("MM_REPLICATE_B"))
+        opt.replicate_b = opt.enabled() && std::atoi(rep) != 0;
+    return opt;
+}
+
+// CPUs of each memory node, restricted to the process affinity mask
+struct NumaTopology {
+    std::vector<std::vector<int>> nodes;
+    std::vector<int> cpu_node;      // cpu -> node index, -1 when not usable
+
+    int num_nodes() const { return (int)nodes.size(); }
+
+    int node_of(int cpu) const {
+        return cpu >= 0 && cpu < (int)cpu_node.size() ? std::max(0, cpu_node[cpu]) : 0;
+    }
+};
+
+// "0-15,32-47" as found in sysfs cpulist and node list files
+inline std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n")
+            continue;
+        size_t dash = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+inline NumaTopology read_numa_topology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    NumaTopology topo;
+    std::string online;
+    std::ifstream online_in("/sys/devices/system/node/online");
+    std::getline(online_in, online);
+    for (int node : parse_cpu_list(online)) {       // node ids may have holes
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string line;
+        if (!std::getline(in, line))
+            continue;
+        std::vector<int> cpus;
+        for (int cpu : parse_cpu_list(line))
+            if (!have_mask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)))
+                cpus.push_back(cpu);
+        if (!cpus.empty())
+            topo.nodes.push_back(cpus);
+    }
+    if (topo.nodes.empty()) {       // no sysfs: one node with every allowed CPU
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (!have_mask || CPU_ISSET(cpu, &allowed))
+                cpus.push_back(cpu);
+        topo.nodes.push_back(cpus);
+    }
+    for (int node = 0; node < topo.num_nodes(); ++node)
+        for (int cpu : topo.nodes[node]) {
+            if (cpu >= (int)topo.cpu_node.size())
+                topo.cpu_node.resize(cpu + 1, -1);
+            topo.cpu_node[cpu] = node;
+        }
+    return topo;
+}
+
+inline const NumaTopology &numa_topology() {
+    static const NumaTopology topo = read_numa_topology();
+    return topo;
+}
+
+inline int current_numa_node() {
+    return numa_topology().node_of(sched_getcpu());
+}
+
+// CPU set for each of num_threads threads under the given policy
+inline std::vector<cpu_set_t> pin_plan(const NumaTopology &topo, PinPolicy policy, int num_threads) {
+    std::vector<cpu_set_t> plan(num_threads);
+    const int nodes = topo.num_nodes();
+    std::vector<int> all;
+    for (const auto &cpus : topo.nodes)
+        all.insert(all.end(), cpus.begin(), cpus.end());
+
+    for (int t = 0; t < num_threads; ++t) {
+        cpu_set_t &set = plan[t];
+        CPU_ZERO(&set);
+        if (policy == PIN_COMPACT) {
+            CPU_SET(all[t % all.size()], &set);
+        } else if (policy == PIN_SCATTER) {
+            const std::vector<int> &cpus = topo.nodes[t % nodes];
+            CPU_SET(cpus[(t / nodes) % cpus.size()], &set);
+        } else if (policy == PIN_SOCKET) {
+            for (int cpu : topo.nodes[(long)t * nodes / num_threads])
+                CPU_SET(cpu, &set);
+        } else {
+            for (int cpu : all)
+                CPU_SET(cpu, &set);
+        }
+    }
+    return plan;
+}
+
+// Binds the calling thread (sched_setaffinity with pid 0 acts on the caller)
+inline bool pin_current_thread(const cpu_set_t &set) {
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+// Pins the threads of an OpenMP team of num_threads. The runtime reuses the
+// same threads for later teams of that size, so the binding sticks.
+inline void pin_omp_team(PinPolicy policy, int num_threads) {
+    if (policy == PIN_NONE)
+        return;
+    std::vector<cpu_set_t> plan = pin_plan(numa_topology(), policy, num_threads);
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(num_threads)
+    pin_current_thread(plan[omp_get_thread_num()]);
+#else
+    pin_current_thread(plan[0]);
+#endif
+}
+
+// One read-only copy of a matrix per node. Every thread of the team calls
+// populate() once; threads copy page-sized chunks of their own node's
+// replica, so the copy is parallel and first-touched on the right node.
+// local() falls back to the source until the caller's replica is complete.
+template <typename T>
+class NumaReplicas {
+public:
+    NumaReplicas(const T *src, size_t count, bool replicate)
+        : src_(src), count_(count),
+          chunks_((count * sizeof(T) + CHUNK_BYTES - 1) / CHUNK_BYTES),
+          replicate_(replicate && numa_topology().num_nodes() > 1) {
+        if (!replicate_)
+            return;
+        for (int node = 0; node < numa_topology().num_nodes(); ++node)
+            replicas_.emplace_back(new Replica(count));
+    }
+
+    NumaReplicas(const NumaReplicas &) = delete;
+    NumaReplicas &operator=(const NumaReplicas &) = delete;
+
+    void populate() {
+        if (!replicate_)
+            return;
+        Replica &rep = *replicas_[current_numa_node()];
+        const size_t per_chunk = CHUNK_BYTES / sizeof(T);
+        for (size_t c; (c = rep.next.fetch_add(1)) < chunks_;) {
+            size_t begin = c * per_chunk, end = std::min(count_, begin + per_chunk);
+            std::memcpy(rep.data.get() + begin, src_ + begin, (end - begin) * sizeof(T));
+            rep.done.fetch_add(1, std::memory_order_release);
+        }
+    }
+
+    // false when replication was not requested or there is only one node
+    bool replicated() const { return replicate_; }
+
+    const T *local() const {
+        if (!replicate_)
+            return src_;
+        const Replica &rep = *replicas_[current_numa_node()];
+        return rep.done.load(std::memory_order_acquire) == chunks_ ? rep.data.get() : src_;
+    }
+
+private:
+    static const size_t CHUNK_BYTES = 64 * 1024;
+
+    struct FreeDeleter {
+        void operator()(T *p) const { std::free(p); }
+    };
+
+    struct Replica {
+        explicit Replica(size_t count)
+            : data(static_cast<T *>(std::aligned_alloc(64, (count * sizeof(T) + 63) / 64 * 64))) {}
+        std::unique_ptr<T, FreeDeleter> data;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> done{0};
+    };
+
+    const T *src_;
+    size_t count_;
+    size_t chunks_;
+    bool replicate_;
+    std::vector<std::unique_ptr<Replica>> replicas_;
+};
+
+#endif
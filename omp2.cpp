@@ -3,52 +3,71 @@
 #include <chrono>
 #include <omp.h>
 #include <algorithm>
+#include "perf_counters.h"
+#include "tiled_kernels.h"
+#include "matrix.h"
+#include "numa.h"
 
 const int N = 4096;         // Matrix size
 const int TILE = 128;        // Only one tile size used
 
-using Matrix = std::vector<std::vector<float>>;
+using Matrix = DenseMatrix<float>;  // One aligned, padded, huge-page buffer; untouched until initialized
 
-void initialize_matrix(Matrix &mat, float value) {
-    for (int i = 0; i < N; ++i)
-        for (int j = 0; j < N; ++j)
-            mat[i][j] = value;
+// Initialize a matrix with a constant value. In NUMA mode every tile is
+// written by the thread that computes the matching C tile, so its pages
+// are allocated on that thread's node.
+void initialize_matrix(Matrix &mat, float value, const NumaOptions &numa) {
+    if (!numa.enabled()) {
+        mat.fill(value);
+        return;
+    }
+    omp_for_tiles<TILE>(N, N, omp_get_max_threads(), true, [&](int i0, int j0) {
+        fill_tile<float, TILE>(mat.data(), N, N, mat.ld(), i0, j0, value);
+    });
 }
 
-void tiled_matrix_multiply(const Matrix &A, const Matrix &B, Matrix &C) {
-    #pragma omp parallel for collapse(2) schedule(dynamic)
-    for (int i0 = 0; i0 < N; i0 += TILE) {
-        for (int j0 = 0; j0 < N; j0 += TILE) {
-            for (int k0 = 0; k0 < N; k0 += TILE) {
-                for (int i = i0; i < std::min(i0 + TILE, N); ++i) {
-                    for (int j = j0; j < std::min(j0 + TILE, N); ++j) {
-                        float sum = C[i][j];
-                        for (int k = k0; k < std::min(k0 + TILE, N); ++k) {
-                            sum += A[i][k] * B[k][j];
-                        }
-                        C[i][j] = sum;
-                    }
-                }
-            }
-        }
-    }
+// Tiled matrix multiplication using OpenMP. NUMA mode uses the static
+// schedule of the first-touch pass and reads B from the local node's replica.
+void tiled_matrix_multiply(const Matrix &A, const NumaReplicas<float> &B, int ldb, Matrix &C,
+                           const NumaOptions &numa) {
+    omp_for_tiles<TILE>(N, N, omp_get_max_threads(), numa.enabled(), [&](int i0, int j0) {
+        TileOperands<float> ops{A.data(), B.local(), C.data(), N, N, N, A.ld(), ldb, C.ld()};
+        tiled_c_tile<float, TILE>(ops, i0, j0, N);
+    });
 }
 
 int main() {
-    Matrix A(N, std::vector<float>(N));
-    Matrix B(N, std::vector<float>(N));
-    Matrix C(N, std::vector<float>(N, 0));
+    NumaOptions numa = numa_options_from_env();
+    pin_omp_team(numa.pin, omp_get_max_threads());
+
+    Matrix A(N, N);
+    Matrix B(N, N);
+    Matrix C(N, N);
 
-    initialize_matrix(A, 1.0f);
-    initialize_matrix(B, 2.0f);
+    initialize_matrix(A, 1.0f, numa);
+    initialize_matrix(B, 2.0f, numa);
+    initialize_matrix(C, 0.0f, numa);
+
+    NumaReplicas<float> B_local(B.data(), B.size(), numa.replicate_b);
+    if (numa.replicate_b) {
+        #pragma omp parallel
+        B_local.populate();
+    }
 
+    PerfCounters counters;
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
-    tiled_matrix_multiply(A, B, C);
+    tiled_matrix_multiply(A, B_local, B.ld(), C, numa);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     std::chrono::duration<double> elapsed = end - start;
     std::cout << "Matrix multiplication completed in " << elapsed.count() << " seconds.\n";
     std::cout << "OpenMP threads used: " << omp_get_max_threads() << std::endl;
+    if (numa.enabled())
+        std::cout << "NUMA nodes: " << numa_topology().num_nodes() << ", pinning: " << pin_policy_name(numa.pin)
+                  << ", B replicated: " << (B_local.replicated() ? "yes" : "no") << std::endl;
+    counters.report(std::cout, 2.0 * N * N * N, true);
 
     return 0;
 }
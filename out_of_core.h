@@ -0,0 +1,304 @@
+#ifndef OUT_OF_CORE_H
+#define OUT_OF_CORE_H
+
+// Out-of-core GEMM over memory-mapped matrix files, for operands that do
+// not fit in RAM:
+//
+//     MappedMatrix A("A.mat"), B("B.mat");
+//     MappedMatrix C("C.mat", A.rows(), B.cols());     // created (sparse, zero)
+//     OutOfCoreStats stats = out_of_core_multiply(A, B, C, 2048);   // memory budget in MB
+//
+// C = A * B is computed one C row panel at a time. A row panel (rows_per_panel
+// x k, contiguous in the file) and the matching C panel stay mapped while B
+// streams through in TILE_L3-row panels, each also contiguous; every step is
+// one packed sgemm on the mapped pages. A dedicated I/O thread works one
+// step ahead: it reads the next B (and A) panel into the page cache and
+// faults it in, so compute threads hit resident pages, and it starts the
+// writeback of each finished C panel and drops panels that are done, so the
+// resident set stays within the budget.
+//
+// File format: a 4 KB header (magic, rows, cols) followed by rows x cols
+// floats, row-major, no padding.
+
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "gemm.h"
+
+const int OOC_TILE_L3 = 512;            // B panel height, the streaming unit
+const size_t OOC_HEADER_BYTES = 4096;
+const uint32_t OOC_MAGIC = 0x54414d4d;  // "MMAT"
+
+struct MatrixFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    int64_t rows;
+    int64_t cols;
+};
+
+class MappedMatrix {
+public:
+    // Opens an existing matrix file
+    explicit MappedMatrix(const std::string &path, bool writable = false) : path_(path) {
+        fd_ = ::open(path.c_str(), writable ? O_RDWR : O_RDONLY);
+        if (fd_ < 0)
+            throw std::runtime_error("cannot open " + path);
+        MatrixFileHeader h;
+        if (::pread(fd_, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || h.magic != OOC_MAGIC || h.rows <= 0 ||
+            h.cols <= 0) {
+            ::close(fd_);
+            throw std::runtime_error(path + " is not a matrix file");
+        }
+        rows_ = h.rows;
+        cols_ = h.cols;
+        map(writable);
+    }
+
+    // Creates (or truncates) a rows x cols file; the data reads as zeros
+    // and takes no disk space until written
+    MappedMatrix(const std::string &path, int64_t rows, int64_t cols) : path_(path), rows_(rows), cols_(cols) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0)
+            throw std::runtime_error("cannot create " + path);
+        MatrixFileHeader h{OOC_MAGIC, 1, rows, cols};
+        if (::pwrite(fd_, &h, sizeof(h), 0) != (ssize_t)sizeof(h) ||
+            ::ftruncate(fd_, OOC_HEADER_BYTES + data_bytes()) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("cannot size " + path);
+        }
+        map(true);
+    }
+
+    MappedMatrix(const MappedMatrix &) = delete;
+    MappedMatrix &operator=(const MappedMatrix &) = delete;
+
+    ~MappedMatrix() {
+        if (base_ != MAP_FAILED)
+            ::munmap(base_, OOC_HEADER_BYTES + data_bytes());
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    int64_t rows() const { return rows_; }
+    int64_t cols() const { return cols_; }
+    int ld() const { return (int)cols_; }
+    size_t data_bytes() const { return (size_t)rows_ * cols_ * sizeof(float); }
+    int fd() const { return fd_; }
+    const std::string &path() const { return path_; }
+
+    float *data() const { return reinterpret_cast<float *>(static_cast<char *>(base_) + OOC_HEADER_BYTES); }
+    float *row(int64_t i) const { return data() + i * cols_; }
+
+    // File offset and length of rows [begin, end)
+    off_t row_offset(int64_t i) const { return (off_t)(OOC_HEADER_BYTES + (size_t)i * cols_ * sizeof(float)); }
+    size_t row_bytes(int64_t begin, int64_t end) const { return (size_t)(end - begin) * cols_ * sizeof(float); }
+
+private:
+    void map(bool writable) {
+        base_ = ::mmap(nullptr, OOC_HEADER_BYTES + data_bytes(), PROT_READ | (writable ? PROT_WRITE : 0),
+                       MAP_SHARED, fd_, 0);
+        if (base_ == MAP_FAILED) {
+            ::close(fd_);
+            fd_ = -1;
+            throw std::runtime_error("cannot map " + path_);
+        }
+    }
+
+    std::string path_;
+    int fd_ = -1;
+    int64_t rows_ = 0;
+    int64_t cols_ = 0;
+    void *base_ = MAP_FAILED;
+};
+
+// Runs posted jobs in order on one background thread
+class IoThread {
+public:
+    IoThread() : worker_([this] { loop(); }) {}
+
+    IoThread(const IoThread &) = delete;
+    IoThread &operator=(const IoThread &) = delete;
+
+    ~IoThread() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        worker_.join();
+    }
+
+    void post(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        wake_.notify_all();
+    }
+
+    // Blocks until every job posted so far has finished
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return jobs_.empty() && !busy_; });
+    }
+
+    double busy_seconds() const { return busy_seconds_; }
+
+private:
+    void loop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+            if (jobs_.empty())
+                return;
+            std::function<void()> job = std::move(jobs_.front());
+            jobs_.pop_front();
+            busy_ = true;
+            lock.unlock();
+            auto start = std::chrono::steady_clock::now();
+            job();
+            busy_seconds_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            lock.lock();
+            busy_ = false;
+            if (jobs_.empty())
+                idle_.notify_all();
+        }
+    }
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<std::function<void()>> jobs_;
+    bool busy_ = false;
+    bool stop_ = false;
+    double busy_seconds_ = 0.0;
+    std::thread worker_;
+};
+
+// Page-aligned [begin, end) around a byte range of a mapping
+inline void page_range(const void *p, size_t bytes, char *&begin, size_t &len) {
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t b = (uintptr_t)p / page * page;
+    uintptr_t e = ((uintptr_t)p + bytes + page - 1) / page * page;
+    begin = (char *)b;
+    len = e - b;
+}
+
+// Pulls rows [begin, end) into the page cache and maps them into the process
+inline void prefetch_rows(const MappedMatrix &M, int64_t begin, int64_t end) {
+    const size_t bytes = M.row_bytes(begin, end);
+    ::readahead(M.fd(), M.row_offset(begin), bytes);
+    char *p;
+    size_t len;
+    page_range(M.row(begin), bytes, p, len);
+    ::madvise(p, len, MADV_WILLNEED);
+    // Take the page faults here rather than on the compute threads
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    volatile char sink = 0;
+    for (size_t off = 0; off < len; off += page)
+        sink = sink + p[off];
+}
+
+// Drops the mapping of rows [begin, end); the page cache keeps (and, for
+// dirty shared pages, still writes back) the data
+inline void release_rows(const MappedMatrix &M, int64_t begin, int64_t end) {
+    char *p;
+    size_t len;
+    page_range(M.row(begin), M.row_bytes(begin, end), p, len);
+    ::madvise(p, len, MADV_DONTNEED);
+}
+
+// Starts writeback of rows [begin, end) without waiting for it
+inline void write_back_rows(const MappedMatrix &M, int64_t begin, int64_t end) {
+    ::sync_file_range(M.fd(), M.row_offset(begin), M.row_bytes(begin, end), SYNC_FILE_RANGE_WRITE);
+}
+
+struct OutOfCoreStats {
+    double seconds = 0.0;
+    double io_busy_seconds = 0.0;   // time the I/O thread spent reading ahead and writing back
+    double flops = 0.0;
+    size_t bytes_streamed = 0;      // A, B and C panel bytes passed through the I/O thread
+    int64_t rows_per_panel = 0;
+};
+
+// A and C row-panel height for a memory budget: what is left after two
+// B panels in flight, split between an A and a C panel (and the next A
+// panel being prefetched), in whole OOC_TILE_L3 tiles
+inline int64_t ooc_rows_per_panel(int64_t m, int64_t n, int64_t k, size_t budget_bytes) {
+    const size_t b_panels = 2 * (size_t)OOC_TILE_L3 * n * sizeof(float);
+    const size_t per_row = (2 * k + n) * sizeof(float);
+    int64_t rows = budget_bytes > b_panels ? (int64_t)((budget_bytes - b_panels) / per_row) : 0;
+    rows = std::max<int64_t>(OOC_TILE_L3, rows / OOC_TILE_L3 * OOC_TILE_L3);
+    return std::min(rows, m);
+}
+
+// C = A * B on mapped files within about budget_mb of resident panels
+inline OutOfCoreStats out_of_core_multiply(const MappedMatrix &A, const MappedMatrix &B, MappedMatrix &C,
+                                           size_t budget_mb) {
+    const int64_t m = A.rows(), k = A.cols(), n = B.cols();
+    if (B.rows() != k || C.rows() != m || C.cols() != n)
+        throw std::invalid_argument("out_of_core_multiply: shape mismatch");
+    if (m > INT32_MAX || n > INT32_MAX || k > INT32_MAX)
+        throw std::invalid_argument("out_of_core_multiply: dimension exceeds sgemm's int range");
+
+    OutOfCoreStats stats;
+    stats.rows_per_panel = ooc_rows_per_panel(m, n, k, budget_mb << 20);
+    stats.flops = 2.0 * m * n * (double)k;
+    const int64_t rp = stats.rows_per_panel;
+    auto start = std::chrono::steady_clock::now();
+    {
+        IoThread io;
+        auto prefetch = [&](const MappedMatrix &M, int64_t begin, int64_t end) {
+            stats.bytes_streamed += M.row_bytes(begin, end);
+            io.post([&M, begin, end] { prefetch_rows(M, begin, end); });
+        };
+
+        prefetch(A, 0, std::min(rp, m));
+        prefetch(B, 0, std::min<int64_t>(OOC_TILE_L3, k));
+        for (int64_t i0 = 0; i0 < m; i0 += rp) {
+            const int64_t i1 = std::min(i0 + rp, m);
+            if (i1 < m)
+                prefetch(A, i1, std::min(i1 + rp, m));
+            for (int64_t p0 = 0; p0 < k; p0 += OOC_TILE_L3) {
+                const int64_t p1 = std::min<int64_t>(p0 + OOC_TILE_L3, k);
+                // Next B panel: the following one, or the first again for the next A panel
+                if (p1 < k)
+                    prefetch(B, p1, std::min<int64_t>(p1 + OOC_TILE_L3, k));
+                else if (i1 < m)
+                    prefetch(B, 0, std::min<int64_t>(OOC_TILE_L3, k));
+
+                // The first k step writes C, later ones accumulate into it
+                sgemm('N', 'N', (int)(i1 - i0), (int)n, (int)(p1 - p0), 1.0f, A.row(i0) + p0, A.ld(), B.row(p0),
+                      B.ld(), p0 == 0 ? 0.0f : 1.0f, C.row(i0), C.ld());
+
+                // A single-panel B is reused as-is by every A panel
+                if (k > OOC_TILE_L3)
+                    io.post([&B, p0, p1] { release_rows(B, p0, p1); });
+            }
+            stats.bytes_streamed += C.row_bytes(i0, i1);
+            io.post([&A, &C, i0, i1] {
+                release_rows(A, i0, i1);
+                write_back_rows(C, i0, i1);
+                release_rows(C, i0, i1);
+            });
+        }
+        io.drain();
+        stats.io_busy_seconds = io.busy_seconds();
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Hardware counter instrumentation through Linux perf_event_open, so the
+// kernels can report IPC and misses per FLOP without VTune.
+//
+//     PerfCounters counters;
+//     counters.start();
+//     tiled_matrix_multiply(A, B, C);
+//     counters.stop();
+//     counters.report(std::cout, 2.0 * N * N * N);
+//
+// start() opens one set of counters on the calling thread with inherit=1,
+// which also covers std::threads spawned afterwards (folded in when they
+// exit), and one set on each other thread of an OpenMP team of the given
+// size, so per-thread numbers are available for OpenMP kernels. Threads that
+// already existed before start() and are not part of that team (a persistent
+// std::thread pool) call attach_current_thread() to be counted. Events the
+// CPU, VM or perf_event_paranoid setting does not allow are reported as n/a.
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+enum PerfEvent {
+    EV_CYCLES,
+    EV_INSTRUCTIONS,
+    EV_L1D_MISSES,
+    EV_LLC_MISSES,
+    EV_DTLB_MISSES,
+    EV_STALLED_CYCLES,
+    EV_TASK_CLOCK,      // ns on CPU, always available
+    NUM_PERF_EVENTS
+};
+
+static const char *const perf_event_names[NUM_PERF_EVENTS] = {
+    "cycles", "instructions", "l1d_misses", "llc_misses", "dtlb_misses", "stalled_cycles", "task_clock_ns"
+};
+
+struct PerfSample {
+    uint64_t value[NUM_PERF_EVENTS] = {};
+    bool valid[NUM_PERF_EVENTS] = {};
+
+    void add(const PerfSample &other) {
+        for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+            value[e] += other.value[e];
+            valid[e] = valid[e] || other.valid[e];
+        }
+    }
+
+    double ratio(PerfEvent num, PerfEvent den) const {
+        return valid[num] && valid[den] && value[den] ? (double)value[num] / value[den] : -1.0;
+    }
+};
+
+class PerfCounters {
+public:
+    PerfCounters() = default;
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+    ~PerfCounters() { close_all(); }
+
+    // Opens and enables counters on this thread and on an OpenMP team of num_threads
+    void start(int num_threads = default_threads()) {
+        close_all();
+        fds_.assign(num_threads, std::vector<int>(NUM_PERF_EVENTS, -1));
+
+#ifdef _OPENMP
+        #pragma omp parallel num_threads(num_threads)
+        open_thread_events(omp_get_thread_num());
+#else
+        open_thread_events(0);
+#endif
+
+        begin_ = std::chrono::steady_clock::now();
+        for (auto &thread : fds_)
+            for (int fd : thread)
+                if (fd >= 0) {
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+                }
+    }
+
+    // Adds counters for the calling thread, enabled immediately. Call between
+    // start() and stop() from threads start() cannot see, e.g. pool workers.
+    void attach_current_thread() {
+        std::vector<int> fds(NUM_PERF_EVENTS, -1);
+        for (int e = 0; e < NUM_PERF_EVENTS; ++e) {
+            fds[e] = open_event((PerfEvent)e, false);
+            if (fds[e] >= 0)
+                ioctl(fds[e], PERF_EVENT_IOC_ENABLE, 0);
+        }
+        std::lock_guard<std::mutex> lock(attach_mutex_);
+        fds_.push_back(fds);
+    }
+
+    // Disables the counters and reads every thread's values
+    void stop() {
+        for (auto &thread : fds_)
+            for (int fd : thread)
+                if (fd >= 0)
+                    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin_).count();
+
+        per_thread_.assign(fds_.size(), PerfSample());
+        total_ = PerfSample();
+        for (size_t t = 0; t < fds_.size(); ++t) {
+            for (int e = 0; e < NUM_PERF_EVENTS; ++e)
+                per_thread_[t].valid[e] = read_event(fds_[t][e], per_thread_[t].value[e]);
+            total_.add(per_thread_[t]);
+        }
+        close_all();
+    }
+
+    bool available() const {
+        for (int e = 0; e < NUM_PERF_EVENTS; ++e)
+            if (total_.valid[e] && e != EV_TASK_CLOCK)
+                return true;
+        return false;
+    }
+
+    double seconds() const { return seconds_; }
+    const PerfSample &total() const { return total_; }
+    const std::vector<PerfSample> &per_thread() const { return per_thread_; }
+
+    // Wall time, IPC and misses per FLOP of the whole run, then per thread
+    void report(std::ostream &os, double flops, bool per_thread = false) const {
+        os << "Counters: wall " << seconds_ << " s";
+        print_sample(os, total_, flops);
+        os << "\n";
+        if (!available())
+            os << "  (hardware events unavailable: check perf_event_paranoid or VM PMU passthrough)\n";
+        if (per_thread)
+            for (size_t t = 0; t < per_thread_.size(); ++t) {
+                os << "  thread " << t;
+                print_sample(os, per_thread_[t], -1.0);
+                os << "\n";
+            }
+    }
+
+private:
+    static int default_threads() {
+#ifdef _OPENMP
+        return omp_get_max_threads();
+#else
+        return 1;
+#endif
+    }
+
+    // Thread 0 is the caller: inherit so spawned std::threads are counted too
+    void open_thread_events(int t) {
+        for (int e = 0; e < NUM_PERF_EVENTS; ++e)
+            fds_[t][e] = open_event((PerfEvent)e, t == 0);
+    }
+
+    static int open_event(PerfEvent ev, bool inherit) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.inherit = inherit ? 1 : 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        const uint64_t read_miss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        switch (ev) {
+        case EV_CYCLES:         attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case EV_INSTRUCTIONS:   attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case EV_L1D_MISSES:     attr.type = PERF_TYPE_HW_CACHE; attr.config = PERF_COUNT_HW_CACHE_L1D | read_miss; break;
+        case EV_LLC_MISSES:     attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+        case EV_DTLB_MISSES:    attr.type = PERF_TYPE_HW_CACHE; attr.config = PERF_COUNT_HW_CACHE_DTLB | read_miss; break;
+        case EV_STALLED_CYCLES: attr.type = PERF_TYPE_HARDWARE; attr.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND; break;
+        case EV_TASK_CLOCK:     attr.type = PERF_TYPE_SOFTWARE; attr.config = PERF_COUNT_SW_TASK_CLOCK; break;
+        default: return -1;
+        }
+
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (fd < 0 && ev == EV_STALLED_CYCLES) {
+            // many Intel cores only expose the frontend stall event
+            attr.config = PERF_COUNT_HW_STALLED_CYCLES_FRONTEND;
+            fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        }
+        return fd;
+    }
+
+    // Scales multiplexed counts by enabled/running time
+    static bool read_event(int fd, uint64_t &value) {
+        if (fd < 0)
+            return false;
+        uint64_t buf[3];
+        if (read(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf) || buf[2] == 0)
+            return false;
+        value = buf[2] < buf[1] ? (uint64_t)((double)buf[0] * buf[1] / buf[2]) : buf[0];
+        return true;
+    }
+
+    static void print_sample(std::ostream &os, const PerfSample &s, double flops) {
+        std::streamsize precision = os.precision(4);
+        auto field = [&](const char *name, double v) {
+            os << ", " << name << " ";
+            if (v < 0)
+                os << "n/a";
+            else
+                os << v;
+        };
+        auto per_flop = [&](PerfEvent e) {
+            return s.valid[e] && flops > 0 ? s.value[e] / flops : -1.0;
+        };
+
+        field("IPC", s.ratio(EV_INSTRUCTIONS, EV_CYCLES));
+        if (flops > 0) {
+            field("L1D miss/FLOP", per_flop(EV_L1D_MISSES));
+            field("LLC miss/FLOP", per_flop(EV_LLC_MISSES));
+            field("dTLB miss/FLOP", per_flop(EV_DTLB_MISSES));
+        } else {
+            field("L1D misses", s.valid[EV_L1D_MISSES] ? (double)s.value[EV_L1D_MISSES] : -1.0);
+            field("LLC misses", s.valid[EV_LLC_MISSES] ? (double)s.value[EV_LLC_MISSES] : -1.0);
+            field("dTLB misses", s.valid[EV_DTLB_MISSES] ? (double)s.value[EV_DTLB_MISSES] : -1.0);
+        }
+        field("stalled", s.ratio(EV_STALLED_CYCLES, EV_CYCLES));
+        field("CPU s", s.valid[EV_TASK_CLOCK] ? s.value[EV_TASK_CLOCK] * 1e-9 : -1.0);
+        os.precision(precision);
+    }
+
+    void close_all() {
+        for (auto &thread : fds_)
+            for (int &fd : thread)
+                if (fd >= 0) {
+                    close(fd);
+                    fd = -1;
+                }
+        fds_.clear();
+    }
+
+    std::vector<std::vector<int>> fds_;
+    std::mutex attach_mutex_;
+    std::vector<PerfSample> per_thread_;
+    PerfSample total_;
+    std::chrono::steady_clock::time_point begin_;
+    double seconds_ = 0.0;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef RNG_H
+#define RNG_H
+
+// Counter-based random matrix generation (Philox4x32-10, Salmon et al.,
+// "Parallel random numbers: as easy as 1, 2, 3", SC'11). Element i of a
+// stream is a pure function of (seed, i), so blocks can be generated by any
+// thread in any order and the output is the same for every thread count,
+// run and machine:
+//
+//     philox_fill_uniform(A, 1, 0.0f, 1.0f);    // DenseMatrix, element (i, j) = index i * cols + j
+//     philox_fill_int(B, 2, 0, 9);              // integers in [0, 9]
+//
+// Rows are split over an OpenMP team; within a row, 16 counters at a time
+// run through a simd loop, 64 values per iteration.
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include "matrix.h"
+
+const uint32_t PHILOX_M0 = 0xD2511F53;
+const uint32_t PHILOX_M1 = 0xCD9E8D57;
+const uint32_t PHILOX_W0 = 0x9E3779B9;     // key schedule (golden ratio, sqrt(3) - 1)
+const uint32_t PHILOX_W1 = 0xBB67AE85;
+const int PHILOX_BLOCK = 16;               // counters per simd batch
+
+struct Philox4x32 {
+    uint32_t v[4];
+};
+
+// Ten rounds over counter (c0, c1, c2, c3) with key (k0, k1)
+inline Philox4x32 philox4x32(uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3, uint32_t k0, uint32_t k1) {
+    uint32_t x0 = c0, x1 = c1, x2 = c2, x3 = c3;
+    for (int r = 0; r < 10; ++r) {
+        const uint64_t p0 = (uint64_t)PHILOX_M0 * x0;
+        const uint64_t p1 = (uint64_t)PHILOX_M1 * x2;
+        const uint32_t y0 = (uint32_t)(p1 >> 32) ^ x1 ^ k0;
+        const uint32_t y2 = (uint32_t)(p0 >> 32) ^ x3 ^ k1;
+        x1 = (uint32_t)p1;
+        x3 = (uint32_t)p0;
+        x0 = y0;
+        x2 = y2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    return Philox4x32{{x0, x1, x2, x3}};
+}
+
+// Raw 32-bit words first .. first + count - 1 of the stream for seed, passed
+// to emit(offset, word) in order; counter (c, 0) yields words 4c .. 4c + 3
+template <typename Emit>
+inline void philox_words(uint64_t seed, uint64_t first, size_t count, Emit emit) {
+    const uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+    size_t done = 0;
+    // Leading words up to a counter boundary
+    for (; done < count && (first + done) % 4 != 0; ++done) {
+        const uint64_t c = (first + done) / 4;
+        emit(done, philox4x32((uint32_t)c, (uint32_t)(c >> 32), 0, 0, k0, k1).v[(first + done) % 4]);
+    }
+    // Whole counters, PHILOX_BLOCK at a time through the simd loop
+    alignas(64) uint32_t words[4][PHILOX_BLOCK];
+    while (count - done >= 4) {
+        const uint64_t c0 = (first + done) / 4;
+        const int blocks = (int)std::min<size_t>(PHILOX_BLOCK, (count - done) / 4);
+        #pragma omp simd
+        for (int b = 0; b < PHILOX_BLOCK; ++b) {
+            const uint64_t c = c0 + b;
+            const Philox4x32 r = philox4x32((uint32_t)c, (uint32_t)(c >> 32), 0, 0, k0, k1);
+            words[0][b] = r.v[0];
+            words[1][b] = r.v[1];
+            words[2][b] = r.v[2];
+            words[3][b] = r.v[3];
+        }
+        for (int b = 0; b < blocks; ++b)
+            for (int w = 0; w < 4; ++w)
+                emit(done + 4 * b + w, words[w][b]);
+        done += 4 * (size_t)blocks;
+    }
+    // Trailing words of a partial counter
+    for (; done < count; ++done) {
+        const uint64_t c = (first + done) / 4;
+        emit(done, philox4x32((uint32_t)c, (uint32_t)(c >> 32), 0, 0, k0, k1).v[(first + done) % 4]);
+    }
+}
+
+// Uniform floats in [lo, hi) from the top 24 bits of each word
+inline void philox_uniform(float *dst, size_t count, uint64_t seed, uint64_t first, float lo, float hi) {
+    const float scale = (hi - lo) * (1.0f / 16777216.0f);
+    philox_words(seed, first, count, [&](size_t i, uint32_t w) { dst[i] = lo + (float)(w >> 8) * scale; });
+}
+
+// Uniform integers in [lo, hi] by multiply-shift; the bias is below 2^-32 * (hi - lo + 1)
+template <typename T>
+inline void philox_int(T *dst, size_t count, uint64_t seed, uint64_t first, int64_t lo, int64_t hi) {
+    const uint64_t range = (uint64_t)(hi - lo) + 1;
+    philox_words(seed, first, count, [&](size_t i, uint32_t w) { dst[i] = (T)(lo + (int64_t)((w * range) >> 32)); });
+}
+
+// Fills the rows x cols part of a matrix in parallel; element (i, j) is word
+// i * cols + j of the stream, whatever the padding or the thread count
+inline void philox_fill_uniform(DenseMatrix<float> &mat, uint64_t seed, float lo, float hi) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < mat.rows(); ++i)
+        philox_uniform(mat.row(i), mat.cols(), seed, (uint64_t)i * mat.cols(), lo, hi);
+}
+
+template <typename T>
+inline void philox_fill_int(DenseMatrix<T> &mat, uint64_t seed, int64_t lo, int64_t hi) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < mat.rows(); ++i)
+        philox_int(mat.row(i), mat.cols(), seed, (uint64_t)i * mat.cols(), lo, hi);
+}
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+// Machine ceilings for a roofline plot, measured on the spot:
+//
+//     RooflineCeilings roof = measure_ceilings(num_threads, detect_caches());
+//     double attainable = roof.attainable(flops_per_byte);   // GFLOP/s
+//
+// The compute roof is an FMA probe: every thread runs ROOFLINE_CHAINS
+// independent multiply-add chains on the widest vectors of the build, enough
+// to cover FMA latency on two ports. The bandwidth roofs are a STREAM triad,
+// a[i] = b[i] + s * c[i] counted as 12 bytes per element as STREAM does, on
+// per-thread arrays sized to sit in L1, L2, L3 or DRAM. Each thread
+// first-touches its own arrays, and the best of ROOFLINE_TRIALS timed runs counts.
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <omp.h>
+#include "autotune.h"
+
+#if defined(__AVX512F__)
+const int ROOFLINE_VEC_BYTES = 64;
+#elif defined(__AVX__)
+const int ROOFLINE_VEC_BYTES = 32;
+#else
+const int ROOFLINE_VEC_BYTES = 16;
+#endif
+const int ROOFLINE_CHAINS = 16;
+const int ROOFLINE_TRIALS = 5;
+const double ROOFLINE_TRIAL_BYTES = 512e6;   // per triad trial, summed over threads and repetitions
+
+enum RooflineLevel { ROOF_L1, ROOF_L2, ROOF_L3, ROOF_DRAM, ROOF_LEVELS };
+
+const char *const roofline_level_names[ROOF_LEVELS] = {"l1", "l2", "l3", "dram"};
+
+struct RooflineCeilings {
+    int threads = 1;
+    double peak_gflops = 0.0;
+    double gbs[ROOF_LEVELS] = {};   // triad bandwidth per level, 0 when the level could not be isolated
+
+    // Arithmetic intensity (FLOP/byte) where DRAM bandwidth stops limiting
+    double ridge() const { return gbs[ROOF_DRAM] > 0.0 ? peak_gflops / gbs[ROOF_DRAM] : 0.0; }
+
+    // Roof at an arithmetic intensity, against DRAM bandwidth
+    double attainable(double flops_per_byte) const {
+        return std::min(peak_gflops, flops_per_byte * gbs[ROOF_DRAM]);
+    }
+};
+
+namespace roofline_detail {
+
+typedef float Vec __attribute__((vector_size(ROOFLINE_VEC_BYTES)));
+
+inline double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Multiply-add chains that neither overflow nor go denormal; returns a sum so
+// the work cannot be dropped
+inline float fma_chains(long iterations) {
+    Vec acc[ROOFLINE_CHAINS];
+    for (int c = 0; c < ROOFLINE_CHAINS; ++c)
+        acc[c] = Vec{} + 1.0f + c * 1e-3f;
+    const Vec x = Vec{} + 0.999999f, y = Vec{} + 1e-6f;
+    for (long it = 0; it < iterations; ++it)
+        for (int c = 0; c < ROOFLINE_CHAINS; ++c)
+            acc[c] = acc[c] * x + y;
+    // Vector adds first: indexing lanes of acc[] would keep it in memory
+    Vec total = acc[0];
+    for (int c = 1; c < ROOFLINE_CHAINS; ++c)
+        total += acc[c];
+    float sum = 0.0f;
+    for (int l = 0; l < ROOFLINE_VEC_BYTES / 4; ++l)
+        sum += total[l];
+    return sum;
+}
+
+}  // namespace roofline_detail
+
+// Peak GFLOP/s of a team running FMA chains for about 50 ms
+inline double roofline_fma_gflops(int threads) {
+    const long iterations = 20000000;
+    const double flops = 2.0 * iterations * ROOFLINE_CHAINS * (ROOFLINE_VEC_BYTES / 4) * threads;
+    double best = 1e30;
+    volatile float sink = 0.0f;
+    for (int trial = 0; trial < ROOFLINE_TRIALS; ++trial) {
+        auto start = std::chrono::steady_clock::now();
+        #pragma omp parallel num_threads(threads)
+        {
+            float s = roofline_detail::fma_chains(iterations / 4 * (trial > 0 ? 4 : 1));
+            #pragma omp atomic
+            sink += s;
+        }
+        if (trial > 0)
+            best = std::min(best, roofline_detail::seconds_since(start));
+    }
+    return flops / best * 1e-9;
+}
+
+// Triad GB/s of a team with bytes_per_thread of arrays per thread
+inline double roofline_triad_gbs(size_t bytes_per_thread, int threads) {
+    const size_t count = std::max<size_t>(64, bytes_per_thread / (3 * sizeof(float)) / 16 * 16);
+    const double trial_bytes = 3.0 * sizeof(float) * count * threads;
+    const int reps = std::max(1, (int)(ROOFLINE_TRIAL_BYTES / trial_bytes));
+    double best = 1e30;
+
+    #pragma omp parallel num_threads(threads)
+    {
+        std::vector<float> a(count, 0.0f), b(count, 1.0f), c(count, 2.0f);
+        float *pa = a.data();
+        const float *pb = b.data(), *pc = c.data();
+        const float s = 0.5f;
+        for (int trial = 0; trial <= ROOFLINE_TRIALS; ++trial) {     // trial 0 warms the caches
+            std::chrono::steady_clock::time_point start;
+            #pragma omp barrier
+            #pragma omp master
+            start = std::chrono::steady_clock::now();
+            #pragma omp barrier
+            for (int r = 0; r < reps; ++r) {
+                #pragma omp simd
+                for (size_t i = 0; i < count; ++i)
+                    pa[i] = pb[i] + s * pc[i];
+                asm volatile("" : : "r"(pa) : "memory");
+            }
+            #pragma omp barrier
+            #pragma omp master
+            if (trial > 0)
+                best = std::min(best, roofline_detail::seconds_since(start) / reps);
+        }
+    }
+    return trial_bytes / best * 1e-9;
+}
+
+// All ceilings for a team. Each level's arrays fill half of it per thread
+// (the team shares L3); DRAM uses 4x L3, at least 256 MB and at most 1 GB in
+// total. A level whose share would fit in the level below is left at 0.
+inline RooflineCeilings measure_ceilings(int threads, const CacheInfo &caches) {
+    RooflineCeilings roof;
+    roof.threads = std::max(1, threads);
+    roof.peak_gflops = roofline_fma_gflops(roof.threads);
+
+    const double l3_share = caches.l3 / 2.0 / roof.threads;
+    const double dram_total = std::min(1024.0 * (1 << 20), std::max(256.0 * (1 << 20), 4.0 * caches.l3));
+    const double bytes[ROOF_LEVELS] = {caches.l1d / 2.0, caches.l2 / 2.0, l3_share, dram_total / roof.threads};
+    for (int level = 0; level < ROOF_LEVELS; ++level) {
+        const double below = level == 0 ? 0.0 : bytes[level - 1];
+        if (bytes[level] > 0.0 && bytes[level] > below)
+            roof.gbs[level] = roofline_triad_gbs((size_t)bytes[level], roof.threads);
+    }
+    return roof;
+}
+
+#endif
@@ -0,0 +1,369 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+// Sparse operands for the 1-5%-dense matrices that waste most of a dense
+// multiply:
+//
+//     CsrMatrix<float> S = csr_from_dense(A);            // or build row_ptr/col_idx/values directly
+//     spmm(S, B, C, omp_get_max_threads());              // C += S * B, B and C dense
+//     CsrMatrix<float> P = spgemm(S, T, nt);             // P = S * T, all CSR
+//     BsrMatrix<float> Sb = bsr_from_csr(S);             // 4 x 4 blocks for SIMD
+//     spmm(Sb, B, C, nt);
+//     multiply_auto(A, B, C, nt);                        // dense or sparse from a density estimate
+//
+// Work is split by nonzeros (SpMM) or by multiply-adds (SpGEMM) rather than
+// by row count, so a few heavy rows do not leave the rest of the team idle.
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <omp.h>
+#include "matrix.h"
+#include "gemm.h"
+
+// Below this fraction of nonzeros in A, multiply_auto runs CSR SpMM instead
+// of the packed dense engine. On AVX-512 the packed engine runs ~110
+// GFLOP/s and SpMM 30-38 GFLOP/s of useful work; counting the conversion,
+// SpMM wins below about 15% (N = 512) to 20% (N = 2048) nonzeros.
+const double SPARSE_DENSITY_THRESHOLD = 0.15;
+
+// Columns of B and C per SpMM register block: 4 zmm (AVX-512) per row
+const int SPMM_NB = 64;
+
+template <typename T>
+struct CsrMatrix {
+    int rows = 0;
+    int cols = 0;
+    std::vector<int64_t> row_ptr;   // rows + 1 entries; row i is [row_ptr[i], row_ptr[i + 1])
+    std::vector<int> col_idx;       // ascending within a row
+    std::vector<T> values;
+
+    int64_t nnz() const { return row_ptr.empty() ? 0 : row_ptr.back(); }
+    double density() const { return rows && cols ? (double)nnz() / ((double)rows * cols) : 0.0; }
+};
+
+// Block CSR: BR x BC dense blocks, row-major inside the block, zero-padded
+// past the matrix edge. A block row of C is updated from BC rows of B at a
+// time, so every B element loaded feeds BR FMAs.
+template <typename T, int BR = 4, int BC = 4>
+struct BsrMatrix {
+    int rows = 0;
+    int cols = 0;
+    std::vector<int64_t> row_ptr;   // per block row
+    std::vector<int> col_idx;       // block column index
+    std::vector<T> values;          // BR * BC per block
+
+    int block_rows() const { return (rows + BR - 1) / BR; }
+    int64_t blocks() const { return row_ptr.empty() ? 0 : row_ptr.back(); }
+};
+
+// Splits rows [0, rows) into parts ranges of about equal cost, where
+// cost(i) = prefix(i + 1) - prefix(i) for a nondecreasing prefix array.
+// Returns parts + 1 boundaries.
+inline std::vector<int> balanced_row_splits(const std::vector<int64_t> &prefix, int parts) {
+    const int rows = (int)prefix.size() - 1;
+    std::vector<int> split(parts + 1, rows);
+    split[0] = 0;
+    const int64_t total = prefix.back() - prefix.front();
+    for (int t = 1; t < parts; ++t) {
+        const int64_t target = prefix.front() + total * t / parts;
+        split[t] = (int)(std::lower_bound(prefix.begin(), prefix.end(), target) - prefix.begin());
+        split[t] = std::min(std::max(split[t], split[t - 1]), rows);
+    }
+    return split;
+}
+
+// Row cost for SpMM: its nonzeros plus one for the C row it writes
+inline std::vector<int64_t> spmm_cost_prefix(const std::vector<int64_t> &row_ptr) {
+    std::vector<int64_t> prefix(row_ptr.size());
+    for (size_t i = 0; i < row_ptr.size(); ++i)
+        prefix[i] = row_ptr[i] + (int64_t)i;
+    return prefix;
+}
+
+template <typename T>
+inline CsrMatrix<T> csr_from_dense(const DenseMatrix<T> &A, int num_threads = omp_get_max_threads()) {
+    CsrMatrix<T> S;
+    S.rows = A.rows();
+    S.cols = A.cols();
+    S.row_ptr.assign(S.rows + 1, 0);
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int i = 0; i < S.rows; ++i) {
+        int64_t count = 0;
+        for (int j = 0; j < S.cols; ++j)
+            count += A(i, j) != T(0);
+        S.row_ptr[i + 1] = count;
+    }
+    for (int i = 0; i < S.rows; ++i)
+        S.row_ptr[i + 1] += S.row_ptr[i];
+    S.col_idx.resize(S.nnz());
+    S.values.resize(S.nnz());
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int i = 0; i < S.rows; ++i) {
+        int64_t p = S.row_ptr[i];
+        for (int j = 0; j < S.cols; ++j)
+            if (A(i, j) != T(0)) {
+                S.col_idx[p] = j;
+                S.values[p++] = A(i, j);
+            }
+    }
+    return S;
+}
+
+template <typename T, int BR = 4, int BC = 4>
+inline BsrMatrix<T, BR, BC> bsr_from_csr(const CsrMatrix<T> &S) {
+    BsrMatrix<T, BR, BC> B;
+    B.rows = S.rows;
+    B.cols = S.cols;
+    const int block_rows = B.block_rows(), block_cols = (S.cols + BC - 1) / BC;
+    B.row_ptr.assign(block_rows + 1, 0);
+    std::vector<int> slot(block_cols, -1);      // block column -> block index in this block row
+    for (int bi = 0; bi < block_rows; ++bi) {
+        const int64_t first = (int64_t)B.col_idx.size();
+        for (int i = bi * BR; i < std::min(S.rows, (bi + 1) * BR); ++i)
+            for (int64_t p = S.row_ptr[i]; p < S.row_ptr[i + 1]; ++p) {
+                const int bj = S.col_idx[p] / BC;
+                if (slot[bj] < 0) {
+                    slot[bj] = (int)(B.col_idx.size() - first);
+                    B.col_idx.push_back(bj);
+                }
+            }
+        std::sort(B.col_idx.begin() + first, B.col_idx.end());
+        for (int64_t b = first; b < (int64_t)B.col_idx.size(); ++b)
+            slot[B.col_idx[b]] = (int)(b - first);
+        B.values.resize(B.col_idx.size() * BR * BC, T(0));
+        for (int i = bi * BR; i < std::min(S.rows, (bi + 1) * BR); ++i)
+            for (int64_t p = S.row_ptr[i]; p < S.row_ptr[i + 1]; ++p) {
+                const int j = S.col_idx[p];
+                const int64_t b = first + slot[j / BC];
+                B.values[b * BR * BC + (i - bi * BR) * BC + j % BC] = S.values[p];
+            }
+        for (int64_t b = first; b < (int64_t)B.col_idx.size(); ++b)
+            slot[B.col_idx[b]] = -1;
+        B.row_ptr[bi + 1] = (int64_t)B.col_idx.size();
+    }
+    return B;
+}
+
+// C[i, j0:j0+nb] += row i of S times B[:, j0:j0+nb]; NB is the register block
+// The NB floats of the C row stay in L1; a local accumulator array here gets
+// unroll-and-jammed by GCC into a scalar loop, 4x slower.
+template <typename T, int NB>
+inline void spmm_row(const CsrMatrix<T> &S, int i, const DenseMatrix<T> &B, DenseMatrix<T> &C, int j0) {
+    T *c = C.row(i) + j0;
+    for (int64_t p = S.row_ptr[i]; p < S.row_ptr[i + 1]; ++p) {
+        const T a = S.values[p];
+        const T *b = B.row(S.col_idx[p]) + j0;
+        #pragma omp simd
+        for (int j = 0; j < NB; ++j)
+            c[j] += a * b[j];
+    }
+}
+
+// Last column block, narrower than SPMM_NB
+template <typename T>
+inline void spmm_row_tail(const CsrMatrix<T> &S, int i, const DenseMatrix<T> &B, DenseMatrix<T> &C, int j0, int nb) {
+    T *c = C.row(i) + j0;
+    for (int64_t p = S.row_ptr[i]; p < S.row_ptr[i + 1]; ++p) {
+        const T a = S.values[p];
+        const T *b = B.row(S.col_idx[p]) + j0;
+        #pragma omp simd
+        for (int j = 0; j < nb; ++j)
+            c[j] += a * b[j];
+    }
+}
+
+// C += S * B with B and C dense. The rows are cut into num_threads
+// nonzero-balanced ranges; thread t of the team OpenMP actually grants runs
+// ranges t, t + team, ..., so a smaller team (OMP_DYNAMIC, OMP_THREAD_LIMIT,
+// a nested call) still covers every row.
+template <typename T>
+inline void spmm(const CsrMatrix<T> &S, const DenseMatrix<T> &B, DenseMatrix<T> &C, int num_threads) {
+    const std::vector<int> split = balanced_row_splits(spmm_cost_prefix(S.row_ptr), num_threads);
+    const int parts = (int)split.size() - 1, n = C.cols();
+    #pragma omp parallel num_threads(num_threads)
+    for (int part = omp_get_thread_num(); part < parts; part += omp_get_num_threads()) {
+        int j0 = 0;
+        for (; j0 + SPMM_NB <= n; j0 += SPMM_NB)
+            for (int i = split[part]; i < split[part + 1]; ++i)
+                spmm_row<T, SPMM_NB>(S, i, B, C, j0);
+        if (j0 < n)
+            for (int i = split[part]; i < split[part + 1]; ++i)
+                spmm_row_tail(S, i, B, C, j0, n - j0);
+    }
+}
+
+template <typename T, int BR, int BC, int NB>
+inline void bsr_block_row(const BsrMatrix<T, BR, BC> &S, int bi, const DenseMatrix<T> &B, DenseMatrix<T> &C,
+                          int j0, int k) {
+    alignas(64) T acc[BR][NB] = {};
+    for (int64_t b = S.row_ptr[bi]; b < S.row_ptr[bi + 1]; ++b) {
+        const T *v = &S.values[b * BR * BC];
+        const int c0 = S.col_idx[b] * BC;
+        for (int c = 0; c < BC && c0 + c < k; ++c) {
+            const T *brow = B.row(c0 + c) + j0;
+            for (int r = 0; r < BR; ++r) {
+                const T a = v[r * BC + c];
+                #pragma omp simd
+                for (int j = 0; j < NB; ++j)
+                    acc[r][j] += a * brow[j];
+            }
+        }
+    }
+    for (int r = 0; r < BR && bi * BR + r < S.rows; ++r) {
+        T *c = C.row(bi * BR + r) + j0;
+        #pragma omp simd
+        for (int j = 0; j < NB; ++j)
+            c[j] += acc[r][j];
+    }
+}
+
+template <typename T, int BR, int BC>
+inline void bsr_block_row_tail(const BsrMatrix<T, BR, BC> &S, int bi, const DenseMatrix<T> &B, DenseMatrix<T> &C,
+                               int j0, int nb, int k) {
+    for (int64_t b = S.row_ptr[bi]; b < S.row_ptr[bi + 1]; ++b) {
+        const T *v = &S.values[b * BR * BC];
+        const int c0 = S.col_idx[b] * BC;
+        for (int c = 0; c < BC && c0 + c < k; ++c)
+            for (int r = 0; r < BR && bi * BR + r < S.rows; ++r) {
+                const T a = v[r * BC + c];
+                const T *brow = B.row(c0 + c) + j0;
+                T *crow = C.row(bi * BR + r) + j0;
+                #pragma omp simd
+                for (int j = 0; j < nb; ++j)
+                    crow[j] += a * brow[j];
+            }
+    }
+}
+
+// C += S * B for block CSR: a BR x NB block of C stays in registers while
+// each BR x BC block of S is applied to BC rows of B. Block-row ranges are
+// dealt over the granted team as in the CSR spmm.
+template <typename T, int BR, int BC>
+inline void spmm(const BsrMatrix<T, BR, BC> &S, const DenseMatrix<T> &B, DenseMatrix<T> &C, int num_threads) {
+    const std::vector<int> split = balanced_row_splits(spmm_cost_prefix(S.row_ptr), num_threads);
+    const int parts = (int)split.size() - 1, n = C.cols(), k = S.cols;
+    #pragma omp parallel num_threads(num_threads)
+    for (int part = omp_get_thread_num(); part < parts; part += omp_get_num_threads()) {
+        for (int j0 = 0; j0 < n; j0 += SPMM_NB) {
+            const int nb = std::min(SPMM_NB, n - j0);
+            for (int bi = split[part]; bi < split[part + 1]; ++bi) {
+                if (nb == SPMM_NB)
+                    bsr_block_row<T, BR, BC, SPMM_NB>(S, bi, B, C, j0, k);
+                else
+                    bsr_block_row_tail<T, BR, BC>(S, bi, B, C, j0, nb, k);
+            }
+        }
+    }
+}
+
+// P = S * T (Gustavson, row by row). Rows are split by multiply-adds into
+// num_threads ranges, dealt over the granted team as in spmm; each thread
+// counts its rows' nonzeros with a marker array, then fills them through a
+// dense accumulator and emits each row with sorted columns.
+template <typename V>
+inline CsrMatrix<V> spgemm(const CsrMatrix<V> &S, const CsrMatrix<V> &T, int num_threads) {
+    CsrMatrix<V> P;
+    P.rows = S.rows;
+    P.cols = T.cols;
+    P.row_ptr.assign(S.rows + 1, 0);
+
+    std::vector<int64_t> flops(S.rows + 1, 0);
+    #pragma omp parallel for schedule(static) num_threads(num_threads)
+    for (int i = 0; i < S.rows; ++i) {
+        int64_t f = 1;
+        for (int64_t p = S.row_ptr[i]; p < S.row_ptr[i + 1]; ++p)
+            f += T.row_ptr[S.col_idx[p] + 1] - T.row_ptr[S.col_idx[p]];
+        flops[i + 1] = f;
+    }
+    for (int i = 0; i < S.rows; ++i)
+        flops[i + 1] += flops[i];
+    const std::vector<int> split = balanced_row_splits(flops, num_threads);
+    const int parts = (int)split.size() - 1;
+
+    #pragma omp parallel num_threads(num_threads)
+    {
+        const int t = omp_get_thread_num(), nt = omp_get_num_threads();
+        std::vector<int> marker(T.cols, -1);
+        for (int part = t; part < parts; part += nt)
+            for (int i = split[part]; i < split[part + 1]; ++i) {
+                int64_t count = 0;
+                for (int64_t p = S.row_ptr[i]; p < S.row_ptr[i + 1]; ++p) {
+                    const int k = S.col_idx[p];
+                    for (int64_t q = T.row_ptr[k]; q < T.row_ptr[k + 1]; ++q)
+                        if (marker[T.col_idx[q]] != i) {
+                            marker[T.col_idx[q]] = i;
+                            ++count;
+                        }
+                }
+                P.row_ptr[i + 1] = count;
+            }
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int i = 0; i < P.rows; ++i)
+                P.row_ptr[i + 1] += P.row_ptr[i];
+            P.col_idx.resize(P.nnz());
+            P.values.resize(P.nnz());
+        }
+
+        std::vector<V> acc(T.cols, V(0));
+        std::fill(marker.begin(), marker.end(), -1);
+        for (int part = t; part < parts; part += nt)
+            for (int i = split[part]; i < split[part + 1]; ++i) {
+                int *cols = P.col_idx.data() + P.row_ptr[i];
+                int count = 0;
+                for (int64_t p = S.row_ptr[i]; p < S.row_ptr[i + 1]; ++p) {
+                    const int k = S.col_idx[p];
+                    const V a = S.values[p];
+                    for (int64_t q = T.row_ptr[k]; q < T.row_ptr[k + 1]; ++q) {
+                        const int j = T.col_idx[q];
+                        if (marker[j] != i) {
+                            marker[j] = i;
+                            cols[count++] = j;
+                            acc[j] = V(0);
+                        }
+                        acc[j] += a * T.values[q];
+                    }
+                }
+                std::sort(cols, cols + count);
+                V *vals = P.values.data() + P.row_ptr[i];
+                for (int c = 0; c < count; ++c)
+                    vals[c] = acc[cols[c]];
+            }
+    }
+    return P;
+}
+
+// Fraction of nonzeros in A from about samples evenly spaced elements
+template <typename T>
+inline double estimate_density(const DenseMatrix<T> &A, int samples = 4096) {
+    const int64_t total = (int64_t)A.rows() * A.cols();
+    if (total == 0)
+        return 0.0;
+    const int64_t step = std::max<int64_t>(1, total / samples);
+    int64_t seen = 0, nonzero = 0;
+    // An odd stride relative to the row length avoids sampling the same columns
+    for (int64_t e = step / 2; e < total; e += step | 1, ++seen)
+        nonzero += A(e / A.cols(), e % A.cols()) != T(0);
+    return seen ? (double)nonzero / seen : 0.0;
+}
+
+// C += A * B, through CSR SpMM when A looks sparse enough and the packed
+// dense engine otherwise. Returns true when the sparse path was taken.
+inline bool multiply_auto(const DenseMatrix<float> &A, const DenseMatrix<float> &B, DenseMatrix<float> &C,
+                          int num_threads) {
+    if (estimate_density(A) < SPARSE_DENSITY_THRESHOLD) {
+        spmm(csr_from_dense(A, num_threads), B, C, num_threads);
+        return true;
+    }
+    int saved = omp_get_max_threads();
+    omp_set_num_threads(num_threads);
+    sgemm('N', 'N', A.rows(), B.cols(), A.cols(), 1.0f, A.data(), A.ld(), B.data(), B.ld(), 1.0f, C.data(),
+          C.ld());
+    omp_set_num_threads(saved);
+    return false;
+}
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+// Strassen-Winograd recursion on top of the 3-level tiled kernel:
+//
+//     StrassenWorkspace ws(512);                 // crossover, task depth from the team size
+//     ws.reserve(m, n, k);                       // optional: allocate outside the timed region
+//     strassen_multiply(TileOperands<float>{A, B, C, m, n, k, lda, ldb, ldc}, ws);
+//
+// Each level splits A, B and C into quadrants and forms C from 7 half-size
+// products and 15 block additions instead of 8 products, 7/8 of the
+// arithmetic per level. Products of blocks with any side at or below the
+// crossover go to tiled_3level_rows. The seven products of the top levels
+// run as OpenMP tasks, each with its own slice of one preallocated
+// workspace; deeper levels run inside their task and reuse one slice per
+// level. An odd m, n or k is peeled: the even part recurses, and the last
+// row, column or rank-1 update of k is added by a plain loop.
+//
+// Unlike the tiled kernels this overwrites C (C = A * B). Rounding error
+// grows with every level, so keep the crossover large enough for the
+// accuracy needed.
+
+#include <algorithm>
+#include <cstddef>
+#include <omp.h>
+#include "tiled_kernels.h"
+#include "matrix.h"
+
+const int STRASSEN_CROSSOVER = 512;
+
+// Tile sizes of the base-case kernel, as in tiled_mm_omp.cpp
+const int STRASSEN_L1 = 64;
+const int STRASSEN_L2 = 128;
+const int STRASSEN_L3 = 512;
+
+class StrassenWorkspace {
+public:
+    // task_depth < 0 picks the number of task levels from num_threads:
+    // enough that 7^depth covers the team
+    explicit StrassenWorkspace(int crossover = STRASSEN_CROSSOVER, int num_threads = omp_get_max_threads(),
+                               int task_depth = -1)
+        : crossover_(std::max(1, crossover)), num_threads_(std::max(1, num_threads)), task_depth_(task_depth) {
+        if (task_depth_ < 0)
+            for (task_depth_ = 0, num_tasks_ = 1; num_tasks_ < num_threads_; num_tasks_ *= 7)
+                ++task_depth_;
+    }
+
+    StrassenWorkspace(const StrassenWorkspace &) = delete;
+    StrassenWorkspace &operator=(const StrassenWorkspace &) = delete;
+
+    ~StrassenWorkspace() { matrix_arena().release(data_); }
+
+    // Grows the buffer to fit an m x n x k product
+    void reserve(int m, int n, int k) {
+        size_t need = floats_needed(m, n, k, 0);
+        if (need <= capacity_)
+            return;
+        matrix_arena().release(data_);
+        data_ = static_cast<float *>(matrix_arena().acquire(need * sizeof(float)));
+        if (!data_)
+            throw std::bad_alloc();
+        capacity_ = need;
+    }
+
+    // True when an m x n x k product is small enough for the base kernel
+    bool is_base(int m, int n, int k) const { return std::min(m, std::min(n, k)) <= crossover_; }
+
+    // Floats used by one level's temporaries: S1-S4 (m/2 x k/2), T1-T4
+    // (k/2 x n/2) and P1, P6, P7 (m/2 x n/2); P2-P5 go straight into C
+    static size_t level_floats(int m, int n, int k) {
+        const int hm = m / 2, hn = n / 2, hk = k / 2;
+        return 4 * (size_t)hm * ld(hk) + 4 * (size_t)hk * ld(hn) + 3 * (size_t)hm * ld(hn);
+    }
+
+    size_t floats_needed(int m, int n, int k, int depth) const {
+        if (is_base(m, n, k))
+            return 0;
+        size_t child = floats_needed(m / 2, n / 2, k / 2, depth + 1);
+        return level_floats(m, n, k) + (depth < task_depth_ ? 7 : 1) * child;
+    }
+
+    // Row stride of a temporary: whole cache lines, and an odd number of
+    // them so power-of-two blocks do not stack their rows in the same sets
+    static int ld(int cols) {
+        int ld = (cols + 15) / 16 * 16;
+        return ld % 32 == 0 ? ld + 16 : ld;
+    }
+
+    float *data() const { return data_; }
+    int crossover() const { return crossover_; }
+    int num_threads() const { return num_threads_; }
+    int task_depth() const { return task_depth_; }
+    size_t bytes() const { return capacity_ * sizeof(float); }
+
+private:
+    int crossover_;
+    int num_threads_;
+    int task_depth_;
+    int num_tasks_ = 1;
+    float *data_ = nullptr;
+    size_t capacity_ = 0;
+};
+
+// Z = X + sign * Y over a rows x cols block. At task levels the rows are
+// split into tasks as well, so the additions do not serialize the team;
+// the caller waits for them with a taskwait.
+inline void strassen_add(int rows, int cols, const float *X, int ldx, const float *Y, int ldy, float sign,
+                         float *Z, int ldz, bool parallel) {
+    #pragma omp taskloop if (parallel) grainsize(64) nogroup
+    for (int i = 0; i < rows; ++i) {
+        const float *x = X + (size_t)i * ldx;
+        const float *y = Y + (size_t)i * ldy;
+        float *z = Z + (size_t)i * ldz;
+        #pragma omp simd
+        for (int j = 0; j < cols; ++j)
+            z[j] = x[j] + sign * y[j];
+    }
+}
+
+// Peeled edges of an m x n x k product whose even part (me x ne x ke) is
+// already in C
+inline void strassen_peel(const TileOperands<float> &ops, int me, int ne, int ke) {
+    const int m = ops.m, n = ops.n, k = ops.k;
+    if (ke < k)     // rank-1 update with the last column of A and row of B
+        for (int i = 0; i < me; ++i) {
+            const float a = ops.A[(size_t)i * ops.lda + k - 1];
+            const float *b = ops.B + (size_t)(k - 1) * ops.ldb;
+            float *c = ops.C + (size_t)i * ops.ldc;
+            #pragma omp simd
+            for (int j = 0; j < ne; ++j)
+                c[j] += a * b[j];
+        }
+    if (me < m) {   // last row of C over the even columns
+        float *c = ops.C + (size_t)(m - 1) * ops.ldc;
+        std::fill(c, c + ne, 0.0f);
+        for (int p = 0; p < k; ++p) {
+            const float a = ops.A[(size_t)(m - 1) * ops.lda + p];
+            const float *b = ops.B + (size_t)p * ops.ldb;
+            #pragma omp simd
+            for (int j = 0; j < ne; ++j)
+                c[j] += a * b[j];
+        }
+    }
+    if (ne < n)     // last column of C, all rows
+        for (int i = 0; i < m; ++i) {
+            const float *a = ops.A + (size_t)i * ops.lda;
+            float sum = 0.0f;
+            #pragma omp simd reduction(+ : sum)
+            for (int p = 0; p < k; ++p)
+                sum += a[p] * ops.B[(size_t)p * ops.ldb + n - 1];
+            ops.C[(size_t)i * ops.ldc + n - 1] = sum;
+        }
+}
+
+// C = A * B; ws points at this call's slice of the workspace
+inline void strassen_recurse(const TileOperands<float> &ops, const StrassenWorkspace &plan, float *ws,
+                             int depth) {
+    const int m = ops.m, n = ops.n, k = ops.k;
+    if (plan.is_base(m, n, k)) {
+        for (int i = 0; i < m; ++i)
+            std::fill(ops.C + (size_t)i * ops.ldc, ops.C + (size_t)i * ops.ldc + n, 0.0f);
+        tiled_3level_rows<float, STRASSEN_L1, STRASSEN_L2, STRASSEN_L3>(ops, 0, m);
+        return;
+    }
+
+    const bool parallel = depth < plan.task_depth();
+    const int hm = m / 2, hn = n / 2, hk = k / 2;
+    const int lda = ops.lda, ldb = ops.ldb, ldc = ops.ldc;
+    const int lsk = StrassenWorkspace::ld(hk), lsn = StrassenWorkspace::ld(hn);
+
+    const float *A11 = ops.A, *A12 = A11 + hk, *A21 = A11 + (size_t)hm * lda, *A22 = A21 + hk;
+    const float *B11 = ops.B, *B12 = B11 + hn, *B21 = B11 + (size_t)hk * ldb, *B22 = B21 + hn;
+    float *C11 = ops.C, *C12 = C11 + hn, *C21 = C11 + (size_t)hm * ldc, *C22 = C21 + hn;
+
+    float *S1 = ws, *S2 = S1 + (size_t)hm * lsk, *S3 = S2 + (size_t)hm * lsk, *S4 = S3 + (size_t)hm * lsk;
+    float *T1 = S4 + (size_t)hm * lsk, *T2 = T1 + (size_t)hk * lsn, *T3 = T2 + (size_t)hk * lsn,
+          *T4 = T3 + (size_t)hk * lsn;
+    float *P1 = T4 + (size_t)hk * lsn, *P6 = P1 + (size_t)hm * lsn, *P7 = P6 + (size_t)hm * lsn;
+    float *child = P7 + (size_t)hm * lsn;
+    const size_t child_floats = plan.floats_needed(hm, hn, hk, depth + 1);
+
+    strassen_add(hm, hk, A21, lda, A22, lda, 1.0f, S1, lsk, parallel);     // S1 = A21 + A22
+    strassen_add(hk, hn, B12, ldb, B11, ldb, -1.0f, T1, lsn, parallel);    // T1 = B12 - B11
+    strassen_add(hm, hk, A11, lda, A21, lda, -1.0f, S3, lsk, parallel);    // S3 = A11 - A21
+    strassen_add(hk, hn, B22, ldb, B12, ldb, -1.0f, T3, lsn, parallel);    // T3 = B22 - B12
+    #pragma omp taskwait
+    strassen_add(hm, hk, S1, lsk, A11, lda, -1.0f, S2, lsk, parallel);     // S2 = S1 - A11
+    strassen_add(hk, hn, B22, ldb, T1, lsn, -1.0f, T2, lsn, parallel);     // T2 = B22 - T1
+    #pragma omp taskwait
+    strassen_add(hm, hk, A12, lda, S2, lsk, -1.0f, S4, lsk, parallel);     // S4 = A12 - S2
+    strassen_add(hk, hn, T2, lsn, B21, ldb, -1.0f, T4, lsn, parallel);     // T4 = T2 - B21
+    #pragma omp taskwait
+
+    const TileOperands<float> products[7] = {
+        {A11, B11, P1, hm, hn, hk, lda, ldb, lsn},      // P1 = A11 * B11
+        {A12, B21, C11, hm, hn, hk, lda, ldb, ldc},     // P2 = A12 * B21
+        {S4, B22, C12, hm, hn, hk, lsk, ldb, ldc},      // P3 = S4 * B22
+        {A22, T4, C21, hm, hn, hk, lda, lsn, ldc},      // P4 = A22 * T4
+        {S1, T1, C22, hm, hn, hk, lsk, lsn, ldc},       // P5 = S1 * T1
+        {S2, T2, P6, hm, hn, hk, lsk, lsn, lsn},        // P6 = S2 * T2
+        {S3, T3, P7, hm, hn, hk, lsk, lsn, lsn},        // P7 = S3 * T3
+    };
+    const StrassenWorkspace *shared_plan = &plan;     // the workspace itself is not copyable
+    for (int p = 0; p < 7; ++p) {
+        const TileOperands<float> product = products[p];
+        float *child_ws = child + (parallel ? p * child_floats : 0);
+        #pragma omp task if (parallel) firstprivate(product, child_ws, shared_plan)
+        strassen_recurse(product, *shared_plan, child_ws, depth + 1);
+    }
+    #pragma omp taskwait
+
+    // With U2 = P1 + P6 and U3 = U2 + P7:
+    // C11 = P1 + P2, C12 = U2 + P5 + P3, C21 = U3 - P4, C22 = U3 + P5
+    #pragma omp taskloop if (parallel) grainsize(64)
+    for (int i = 0; i < hm; ++i) {
+        const float *p1 = P1 + (size_t)i * lsn, *p6 = P6 + (size_t)i * lsn, *p7 = P7 + (size_t)i * lsn;
+        float *c11 = C11 + (size_t)i * ldc, *c12 = C12 + (size_t)i * ldc;
+        float *c21 = C21 + (size_t)i * ldc, *c22 = C22 + (size_t)i * ldc;
+        #pragma omp simd
+        for (int j = 0; j < hn; ++j) {
+            const float u2 = p1[j] + p6[j];
+            const float u3 = u2 + p7[j];
+            c11[j] += p1[j];
+            c12[j] += u2 + c22[j];
+            c21[j] = u3 - c21[j];
+            c22[j] += u3;
+        }
+    }
+
+    strassen_peel(ops, 2 * hm, 2 * hn, 2 * hk);
+}
+
+// C = A * B with ws.num_threads() threads; small products skip the recursion
+// and run on the tiled OpenMP kernel directly
+inline void strassen_multiply(const TileOperands<float> &ops, StrassenWorkspace &ws) {
+    if (ops.m == 0 || ops.n == 0)
+        return;
+    if (ws.is_base(ops.m, ops.n, ops.k)) {
+        for (int i = 0; i < ops.m; ++i)
+            std::fill(ops.C + (size_t)i * ops.ldc, ops.C + (size_t)i * ops.ldc + ops.n, 0.0f);
+        tiled_3level_omp<float, STRASSEN_L1, STRASSEN_L2, STRASSEN_L3>(ops, ws.num_threads());
+        return;
+    }
+    ws.reserve(ops.m, ops.n, ops.k);
+    #pragma omp parallel num_threads(ws.num_threads())
+    #pragma omp single
+    strassen_recurse(ops, ws, ws.data(), 0);
+}
+
+#endif
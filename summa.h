@@ -0,0 +1,287 @@
+#ifndef SUMMA_H
+#define SUMMA_H
+
+// Distributed C = A * B over processes (SUMMA, van de Geijn and Watts 1997,
+// with the 2.5D replication of Solomonik and Demmel 2011):
+//
+//     SummaGrid g = summa_grid(t.size(), layers, t.rank());
+//     DenseMatrix<float> A(summa_local_rows(m, nb, g), summa_local_cols(k, nb, g)), ...;
+//     SummaStats s = summa_multiply(t, g, m, n, k, nb, A, B, C, num_threads);
+//
+// The procs = rows x cols x layers processes form a grid of `layers` stacked
+// rows x cols planes. A, B and C are split into nb x nb blocks dealt out
+// block-cyclically over each plane: block (I, J) lives on process row
+// I % rows, column J % cols, so ragged and uneven shapes still share the
+// work. Local blocks are stored packed in global order, one DenseMatrix per
+// operand; block_cyclic_global maps a local index back.
+//
+// Layer 0 holds the inputs and broadcasts them up the layers at the start.
+// Layer l then runs the SUMMA steps of k-block K = l, l + layers, ...: the
+// owners of A's block column K broadcast it along their process row, the
+// owners of B's block row K broadcast it down their process column, and every
+// process adds the panel product to its C blocks with the OpenMP tiled kernel
+// (tiled_3level_omp_dispatch). Finally, each layer's partial C is summed onto
+// layer 0. More layers means fewer, larger steps per plane; it pays the
+// replication and reduction in exchange.
+//
+// The broadcasts run on a communication thread one step ahead of the
+// compute, through two panel slots. The next panels travel while the OpenMP
+// team works on the current ones. SummaStats records how long the compute
+// thread still waited for them.
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include "matrix.h"
+#include "tiled_kernels.h"
+#include "transport.h"
+
+struct SummaGrid {
+    int rows = 1;
+    int cols = 1;
+    int layers = 1;
+    int row = 0;        // this process
+    int col = 0;
+    int layer = 0;
+
+    int rank_of(int r, int c, int l) const { return (l * rows + r) * cols + c; }
+};
+
+struct SummaStats {
+    double seconds = 0.0;       // whole call
+    double compute_s = 0.0;     // local panel products
+    double wait_s = 0.0;        // compute thread waiting for panels
+    double comm_s = 0.0;        // communication thread moving panels
+    double replicate_s = 0.0;   // inputs up the layers and partial C back down
+    double bytes_sent = 0.0;
+    int steps = 0;              // panels this process multiplied
+};
+
+// Planes as square as procs / layers allows, rows <= cols. Throws
+// std::invalid_argument when layers does not divide procs.
+inline SummaGrid summa_grid(int procs, int layers, int rank) {
+    if (procs < 1 || layers < 1 || procs % layers != 0)
+        throw std::invalid_argument("summa_grid: " + std::to_string(layers) + " layers do not divide " +
+                                    std::to_string(procs) + " processes");
+    SummaGrid g;
+    const int plane = procs / layers;
+    g.layers = layers;
+    for (int r = 1; r * r <= plane; ++r)
+        if (plane % r == 0)
+            g.rows = r;
+    g.cols = plane / g.rows;
+    g.layer = rank / plane;
+    g.row = rank % plane / g.cols;
+    g.col = rank % g.cols;
+    return g;
+}
+
+// Elements of an extent of n, dealt in nb blocks over procs, that land on coord
+inline int block_cyclic_extent(int n, int nb, int procs, int coord) {
+    const int blocks = (n + nb - 1) / nb;
+    int mine = blocks / procs + (coord < blocks % procs ? 1 : 0);
+    int extent = mine * nb;
+    if (mine > 0 && (blocks - 1) % procs == coord)
+        extent -= blocks * nb - n;      // this process holds the ragged last block
+    return extent;
+}
+
+// Global index of local index `local` on coord
+inline int block_cyclic_global(int local, int nb, int procs, int coord) {
+    return (local / nb * procs + coord) * nb + local % nb;
+}
+
+// This process's share of a rows x cols matrix
+inline int summa_local_rows(int rows, int nb, const SummaGrid &g) {
+    return block_cyclic_extent(rows, nb, g.rows, g.row);
+}
+
+inline int summa_local_cols(int cols, int nb, const SummaGrid &g) {
+    return block_cyclic_extent(cols, nb, g.cols, g.col);
+}
+
+namespace summa_detail {
+
+// One step's panels: A's block column (local rows x kb) and B's block row
+// (kb x local cols). Each points into this process's own operand when it
+// owns the block, else into the slot's receive buffer.
+struct Panel {
+    std::vector<float> a_buf, b_buf;
+    const float *a = nullptr;
+    const float *b = nullptr;
+    int lda = 0;
+    int ldb = 0;
+    int kb = 0;
+};
+
+inline double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace summa_detail
+
+// C = A * B for this process's blocks of the m x k A, k x n B and m x n C.
+// On layers above 0, A and B are only received into. Every process calls it
+// with the same shapes, nb and grid shape, and allocates its blocks the same
+// way: a panel or partial C travels with its owner's row stride. Throws
+// std::invalid_argument when the local shapes do not match the grid, or when
+// a process would own no block of some operand.
+inline SummaStats summa_multiply(Transport &t, const SummaGrid &g, int m, int n, int k, int nb,
+                                 DenseMatrix<float> &A, DenseMatrix<float> &B, DenseMatrix<float> &C,
+                                 int num_threads) {
+    if (nb < 1 || (m + nb - 1) / nb < g.rows || (n + nb - 1) / nb < g.cols ||
+        (k + nb - 1) / nb < std::max(g.rows, g.cols))
+        throw std::invalid_argument("summa_multiply: too few " + std::to_string(nb) + "-blocks for a " +
+                                    std::to_string(g.rows) + " x " + std::to_string(g.cols) + " grid");
+    const int ml = summa_local_rows(m, nb, g), nl = summa_local_cols(n, nb, g);
+    if (A.rows() != ml || A.cols() != summa_local_cols(k, nb, g) || B.rows() != summa_local_rows(k, nb, g) ||
+        B.cols() != nl || C.rows() != ml || C.cols() != nl)
+        throw std::invalid_argument("summa_multiply: local blocks do not match the grid");
+
+    SummaStats stats;
+    const uint64_t sent0 = t.bytes_sent();
+    auto start = std::chrono::steady_clock::now();
+    C.fill(0.0f);
+
+    // Inputs from layer 0 to the other layers, down each (row, col) fibre
+    if (g.layers > 1) {
+        auto phase = std::chrono::steady_clock::now();
+        std::vector<int> fibre;
+        for (int l = 0; l < g.layers; ++l)
+            fibre.push_back(g.rank_of(g.row, g.col, l));
+        broadcast(t, fibre, 0, A.data(), (size_t)A.rows() * A.ld() * sizeof(float));
+        broadcast(t, fibre, 0, B.data(), (size_t)B.rows() * B.ld() * sizeof(float));
+        stats.replicate_s += summa_detail::seconds_since(phase);
+    }
+
+    std::vector<int> row_group, col_group;
+    for (int c = 0; c < g.cols; ++c)
+        row_group.push_back(g.rank_of(g.row, c, g.layer));
+    for (int r = 0; r < g.rows; ++r)
+        col_group.push_back(g.rank_of(r, g.col, g.layer));
+
+    std::vector<int> steps;
+    for (int K = g.layer; K < (k + nb - 1) / nb; K += g.layers)
+        steps.push_back(K);
+    stats.steps = (int)steps.size();
+
+    summa_detail::Panel slots[2];
+    for (summa_detail::Panel &p : slots) {
+        p.a_buf.resize((size_t)ml * nb);
+        p.b_buf.resize((size_t)nb * B.ld());
+    }
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t delivered = 0, consumed = 0;
+    std::exception_ptr comm_error;
+
+    // Communication thread: fills slot s % 2 once the compute is done with
+    // step s - 2
+    std::thread comm([&] {
+        try {
+            for (size_t s = 0; s < steps.size(); ++s) {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&] { return s < consumed + 2; });
+                }
+                auto phase = std::chrono::steady_clock::now();
+                summa_detail::Panel &p = slots[s % 2];
+                const int K = steps[s];
+                p.kb = std::min(nb, k - K * nb);
+
+                const int a_root = K % g.cols, a_col = K / g.cols * nb;
+                if (g.cols == 1) {
+                    p.a = A.data() + a_col;
+                    p.lda = A.ld();
+                } else {
+                    if (g.col == a_root)
+                        for (int i = 0; i < ml; ++i)
+                            std::memcpy(&p.a_buf[(size_t)i * p.kb], A.row(i) + a_col, p.kb * sizeof(float));
+                    broadcast(t, row_group, a_root, p.a_buf.data(), (size_t)ml * p.kb * sizeof(float));
+                    p.a = p.a_buf.data();
+                    p.lda = p.kb;
+                }
+
+                // Whole rows of B: contiguous, and the same ld down a process column
+                const int b_root = K % g.rows;
+                float *b_rows = g.row == b_root ? B.row(K / g.rows * nb) : p.b_buf.data();
+                if (g.rows > 1)
+                    broadcast(t, col_group, b_root, b_rows, (size_t)p.kb * B.ld() * sizeof(float));
+                p.b = b_rows;
+                p.ldb = B.ld();
+
+                stats.comm_s += summa_detail::seconds_since(phase);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    delivered = s + 1;
+                }
+                cv.notify_all();
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            comm_error = std::current_exception();
+            delivered = steps.size();
+            cv.notify_all();
+        }
+    });
+
+    for (size_t s = 0; s < steps.size(); ++s) {
+        auto wait = std::chrono::steady_clock::now();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&] { return s < delivered; });
+            if (comm_error)
+                break;
+        }
+        auto phase = std::chrono::steady_clock::now();
+        stats.wait_s += std::chrono::duration<double>(phase - wait).count();
+
+        const summa_detail::Panel &p = slots[s % 2];
+        TileOperands<float> ops{p.a, p.b, C.data(), ml, nl, p.kb, p.lda, p.ldb, C.ld()};
+        tiled_3level_omp_dispatch(ops, num_threads);
+        stats.compute_s += summa_detail::seconds_since(phase);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            consumed = s + 1;
+        }
+        cv.notify_all();
+    }
+    comm.join();
+    if (comm_error)
+        std::rethrow_exception(comm_error);
+
+    // Partial products of the upper layers summed onto layer 0
+    if (g.layers > 1) {
+        auto phase = std::chrono::steady_clock::now();
+        const size_t bytes = (size_t)C.rows() * C.ld() * sizeof(float);
+        if (g.layer == 0) {
+            std::vector<float> part((size_t)C.rows() * C.ld());
+            for (int l = 1; l < g.layers; ++l) {
+                t.recv(g.rank_of(g.row, g.col, l), part.data(), bytes);
+                for (int i = 0; i < C.rows(); ++i) {
+                    float *c = C.row(i);
+                    const float *q = &part[(size_t)i * C.ld()];
+                    #pragma omp simd
+                    for (int j = 0; j < C.cols(); ++j)
+                        c[j] += q[j];
+                }
+            }
+        } else {
+            t.send(g.rank_of(g.row, g.col, 0), C.data(), bytes);
+        }
+        stats.replicate_s += summa_detail::seconds_since(phase);
+    }
+
+    stats.seconds = summa_detail::seconds_since(start);
+    stats.bytes_sent = (double)(t.bytes_sent() - sent0);
+    return stats;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef TEAM_PLAN_H
+#define TEAM_PLAN_H
+
+// Team size for programs that run their own tile loops. gemm_plan sizes
+// sgemm's team from the packed engine's cost model; a scalar or tiled loop
+// runs at a different rate, so these programs time one task of their own
+// kernel (time_best, usually on scratch operands shaped like one tile) and
+// plan_team picks the team from that:
+//
+//     double tile_s = time_best([&] { tiled_c_tile<float, 128>(scratch, 0, 0, 128); });
+//     int num_threads = plan_team(tiles * tiles, tile_s, max_threads).num_threads;
+//
+// Header-only; it needs neither libgemm nor a tune file.
+
+#include <algorithm>
+#include <chrono>
+
+// Starting or waking one more worker and joining it, from std::thread create
+// plus join and OpenMP fork/join on a few x86 servers
+const double TEAM_THREAD_START_US = 20.0;
+
+// Thread counts are tried in increasing order and a bigger team must save at
+// least this fraction of the time, as in gemm_plan
+const double TEAM_MIN_GAIN = 0.05;
+
+struct TeamPlan {
+    int num_threads;    // 1 .. max_threads, never more than tasks
+    double seconds;     // predicted
+};
+
+// Best wall time of reps calls of fn after one warm-up call
+template <typename Fn>
+inline double time_best(Fn fn, int reps = 1) {
+    fn();
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+// Smallest team that runs `tasks` equal tasks of task_seconds each: t threads
+// take ceil(tasks / t) rounds plus thread_start_us for every thread after
+// the first. Shared-bandwidth limits are not modelled; cap max_threads for
+// memory-bound kernels.
+inline TeamPlan plan_team(int tasks, double task_seconds, int max_threads,
+                          double thread_start_us = TEAM_THREAD_START_US) {
+    auto seconds_for = [&](int t) {
+        return (tasks + t - 1) / t * task_seconds + (t - 1) * thread_start_us * 1e-6;
+    };
+    TeamPlan plan{1, seconds_for(1)};
+    for (int t = 2; t <= std::min(max_threads, tasks); ++t) {
+        double s = seconds_for(t);
+        if (s < plan.seconds * (1.0 - TEAM_MIN_GAIN)) {
+            plan.seconds = s;
+            plan.num_threads = t;
+        }
+    }
+    return plan;
+}
+
+#endif
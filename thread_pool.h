@@ -0,0 +1,182 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// Persistent std::thread pool with per-thread tile deques and randomized work
+// stealing, replacing the one-shot spawn/join over static row bands.
+//
+//     WorkStealingPool pool(NUM_THREADS);
+//     pool.run_tiles(tiles_i, tiles_j, [&](int ti, int tj) { ... });
+//     pool.run_on_each_thread([&](int id) { ... });   // e.g. attach counters
+//
+// run_tiles() deals the (ti, tj) macro-tiles out in contiguous row-major
+// chunks, one per worker, so each worker starts on a band as before. A worker
+// pops its own deque from the front; when it runs dry it steals from the back
+// of a randomly chosen victim. No new tiles appear during a job, so a worker
+// that finds every deque empty is done, and the slowest thread can only run
+// past the others by the one tile it is still computing.
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(int num_threads = (int)std::thread::hardware_concurrency())
+        : num_threads_(num_threads > 0 ? num_threads : 1) {
+        for (int t = 0; t < num_threads_; ++t)
+            queues_.emplace_back(new TileQueue);
+        for (int t = 0; t < num_threads_; ++t)
+            threads_.emplace_back(&WorkStealingPool::worker_loop, this, t);
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        start_cv_.notify_all();
+        for (auto &thread : threads_)
+            thread.join();
+    }
+
+    int size() const { return num_threads_; }
+
+    // Tiles taken from another worker's deque since the pool was created
+    long steals() const { return steals_.load(std::memory_order_relaxed); }
+
+    // Calls fn(ti, tj) once for every tile of a tiles_i x tiles_j grid and
+    // returns when all of them are done. Not reentrant. Without stealing every
+    // worker runs exactly its dealt chunk, which is how first-touch
+    // initialization maps tiles to the threads that will compute them.
+    void run_tiles(int tiles_i, int tiles_j, const std::function<void(int, int)> &fn, bool steal = true) {
+        int total = tiles_i * tiles_j;
+        if (total <= 0)
+            return;
+        int chunk = (total + num_threads_ - 1) / num_threads_;
+        run_job(fn, tiles_j, steal, [&](int t, std::deque<int> &tiles) {
+            for (int tile = t * chunk; tile < std::min(total, (t + 1) * chunk); ++tile)
+                tiles.push_back(tile);
+        });
+    }
+
+    // Calls fn(id) exactly once on every worker thread, with stealing disabled
+    void run_on_each_thread(const std::function<void(int)> &fn) {
+        std::function<void(int, int)> job = [&](int t, int) { fn(t); };
+        run_job(job, 1, false, [](int t, std::deque<int> &tiles) { tiles.push_back(t); });
+    }
+
+private:
+    struct alignas(64) TileQueue {
+        std::mutex lock;
+        std::deque<int> tiles;      // linear tile indices, ti * tiles_j + tj
+    };
+
+    template <typename Deal>
+    void run_job(const std::function<void(int, int)> &fn, int tiles_j, bool steal, Deal deal) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        job_ = &fn;
+        tiles_j_ = tiles_j;
+        steal_ = steal;
+        finished_ = 0;
+        for (int t = 0; t < num_threads_; ++t) {
+            std::lock_guard<std::mutex> qlock(queues_[t]->lock);
+            deal(t, queues_[t]->tiles);
+        }
+        ++generation_;
+        start_cv_.notify_all();
+        done_cv_.wait(lock, [&] { return finished_ == num_threads_; });
+        job_ = nullptr;
+    }
+
+    void worker_loop(int id) {
+        uint32_t rng = 2654435761u * (uint32_t)(id + 1);
+        uint64_t seen = 0;
+        for (;;) {
+            const std::function<void(int, int)> *job;
+            int tiles_j;
+            bool steal_enabled;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                if (stop_)
+                    return;
+                seen = generation_;
+                job = job_;
+                tiles_j = tiles_j_;
+                steal_enabled = steal_;
+            }
+
+            int tile;
+            while (pop_local(id, tile) || (steal_enabled && steal(id, rng, tile)))
+                (*job)(tile / tiles_j, tile % tiles_j);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (++finished_ == num_threads_)
+                    done_cv_.notify_one();
+            }
+        }
+    }
+
+    bool pop_local(int id, int &tile) {
+        TileQueue &q = *queues_[id];
+        std::lock_guard<std::mutex> lock(q.lock);
+        if (q.tiles.empty())
+            return false;
+        tile = q.tiles.front();
+        q.tiles.pop_front();
+        return true;
+    }
+
+    // Tries every other worker once, starting from a random victim
+    bool steal(int id, uint32_t &rng, int &tile) {
+        if (num_threads_ == 1)
+            return false;
+        rng ^= rng << 13;
+        rng ^= rng >> 17;
+        rng ^= rng << 5;
+        int start = (int)(rng % (uint32_t)num_threads_);
+        for (int i = 0; i < num_threads_; ++i) {
+            int victim = (start + i) % num_threads_;
+            if (victim == id)
+                continue;
+            TileQueue &q = *queues_[victim];
+            std::lock_guard<std::mutex> lock(q.lock);
+            if (!q.tiles.empty()) {
+                tile = q.tiles.back();
+                q.tiles.pop_back();
+                steals_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const int num_threads_;
+    std::vector<std::unique_ptr<TileQueue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable start_cv_;
+    std::condition_variable done_cv_;
+    uint64_t generation_ = 0;
+    bool stop_ = false;
+    int finished_ = 0;
+    const std::function<void(int, int)> *job_ = nullptr;
+    int tiles_j_ = 1;
+    bool steal_ = true;
+
+    std::atomic<long> steals_{0};
+};
+
+#endif
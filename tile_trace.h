@@ -0,0 +1,186 @@
+#ifndef TILE_TRACE_H
+#define TILE_TRACE_H
+
+// Per-thread timeline of the tile loops, written as Chrome trace JSON that
+// chrome://tracing and ui.perfetto.dev open directly:
+//
+//     const char *path = tile_trace_from_env();     // TILE_TRACE=trace.json, or tile_trace_enable()
+//     { TileTraceScope scope("L3 tile", i3, j3); ... }
+//     if (path) tile_trace_write(path);
+//
+// The tile kernels in tiled_kernels.h carry the scopes, so they are always
+// compiled in. A disabled scope costs one predictable branch on a relaxed
+// load. An enabled one reads the TSC twice (rdtsc) and stores one 32-byte
+// event in the calling thread's ring: a preallocated, power-of-two array with
+// a single writer, so there are no locks or atomic read-modify-writes on the
+// hot path, and a full ring overwrites its oldest events. A thread claims its
+// ring with one fetch_add the first time it records. tile_trace_write
+// must run after the traced work, when no thread is recording.
+
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <x86intrin.h>
+
+const int TRACE_MAX_THREADS = 256;
+const size_t TRACE_RING_EVENTS = (size_t)1 << 16;  // per thread, 2 MB
+
+struct TraceEvent {
+    uint64_t begin;         // TSC ticks
+    uint64_t end;
+    const char *name;       // string literal, never copied
+    int32_t i;
+    int32_t j;
+};
+
+namespace trace_detail {
+
+struct alignas(64) Ring {
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<uint64_t> head{0};  // events ever written; slot head % TRACE_RING_EVENTS is next
+};
+
+struct State {
+    std::atomic<bool> enabled{false};
+    std::atomic<int> rings_claimed{0};
+    std::atomic<uint64_t> lost{0};  // events of threads past TRACE_MAX_THREADS
+    Ring rings[TRACE_MAX_THREADS];
+    uint64_t tsc0 = 0;
+    std::chrono::steady_clock::time_point time0;
+};
+
+inline State &state() {
+    static State s;
+    return s;
+}
+
+inline thread_local Ring *ring = nullptr;
+inline thread_local bool no_ring = false;
+
+// Slow path, once per thread
+__attribute__((noinline)) inline Ring *claim_ring() {
+    State &s = state();
+    const int slot = s.rings_claimed.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= TRACE_MAX_THREADS) {
+        no_ring = true;
+        return nullptr;
+    }
+    Ring &r = s.rings[slot];
+    r.events.reset(new TraceEvent[TRACE_RING_EVENTS]);
+    return ring = &r;
+}
+
+inline void record(const char *name, int i, int j, uint64_t begin, uint64_t end) {
+    Ring *r = ring;
+    if (!r) {
+        if (no_ring || !(r = claim_ring())) {
+            state().lost.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    const uint64_t h = r->head.load(std::memory_order_relaxed);
+    r->events[h & (TRACE_RING_EVENTS - 1)] = TraceEvent{begin, end, name, i, j};
+    r->head.store(h + 1, std::memory_order_release);
+}
+
+}  // namespace trace_detail
+
+inline bool tile_trace_enabled() {
+    return trace_detail::state().enabled.load(std::memory_order_relaxed);
+}
+
+// Starts recording from empty rings. The TSC and steady_clock are sampled
+// here and again at write time to convert ticks to microseconds.
+inline void tile_trace_enable() {
+    trace_detail::State &s = trace_detail::state();
+    for (int t = 0; t < std::min(s.rings_claimed.load(std::memory_order_relaxed), TRACE_MAX_THREADS); ++t)
+        s.rings[t].head.store(0, std::memory_order_relaxed);
+    s.lost.store(0, std::memory_order_relaxed);
+    s.time0 = std::chrono::steady_clock::now();
+    s.tsc0 = __rdtsc();
+    s.enabled.store(true, std::memory_order_relaxed);
+}
+
+inline void tile_trace_disable() {
+    trace_detail::state().enabled.store(false, std::memory_order_relaxed);
+}
+
+// Enables tracing when $TILE_TRACE names an output file and returns it, else nullptr
+inline const char *tile_trace_from_env() {
+    const char *path = std::getenv("TILE_TRACE");
+    if (!path || !*path)
+        return nullptr;
+    tile_trace_enable();
+    return path;
+}
+
+// Times its own lifetime as one event of the calling thread, tagged with a
+// tile's coordinates
+class TileTraceScope {
+public:
+    explicit TileTraceScope(const char *name, int i = 0, int j = 0)
+        : name_(name), i_(i), j_(j), begin_(tile_trace_enabled() ? __rdtsc() : 0) {}
+
+    ~TileTraceScope() {
+        if (begin_)
+            trace_detail::record(name_, i_, j_, begin_, __rdtsc());
+    }
+
+    TileTraceScope(const TileTraceScope &) = delete;
+    TileTraceScope &operator=(const TileTraceScope &) = delete;
+
+private:
+    const char *name_;
+    int i_, j_;
+    uint64_t begin_;
+};
+
+// Writes every recorded event as a Chrome "X" (complete) event, one track
+// per recording thread, and disables tracing. Returns the number of events
+// written, or -1 when the file cannot be written.
+inline long tile_trace_write(const std::string &path) {
+    trace_detail::State &s = trace_detail::state();
+    tile_trace_disable();
+
+    // TSC rate over the traced interval; stretch it to 10 ms for a stable ratio
+    auto now = std::chrono::steady_clock::now();
+    while (now - s.time0 < std::chrono::milliseconds(10))
+        now = std::chrono::steady_clock::now();
+    const double us = std::chrono::duration<double, std::micro>(now - s.time0).count();
+    const double ticks_per_us = (double)(__rdtsc() - s.tsc0) / us;
+
+    std::ofstream out(path);
+    if (!out)
+        return -1;
+    out.precision(3);
+    out << std::fixed << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    long written = 0;
+    uint64_t overwritten = 0;
+    const int rings = std::min(s.rings_claimed.load(std::memory_order_relaxed), TRACE_MAX_THREADS);
+    for (int t = 0; t < rings; ++t) {
+        const trace_detail::Ring &r = s.rings[t];
+        const uint64_t head = r.head.load(std::memory_order_acquire);
+        const uint64_t first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        overwritten += first;
+        out << (t ? ",\n" : "") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << t
+            << ", \"args\": {\"name\": \"thread " << t << "\"}}";
+        for (uint64_t e = first; e < head; ++e) {
+            const TraceEvent &ev = r.events[e & (TRACE_RING_EVENTS - 1)];
+            out << ",\n{\"name\": \"" << ev.name << "\", \"cat\": \"tile\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << t
+                << ", \"ts\": " << (double)(ev.begin - s.tsc0) / ticks_per_us
+                << ", \"dur\": " << (double)(ev.end - ev.begin) / ticks_per_us << ", \"args\": {\"i\": " << ev.i
+                << ", \"j\": " << ev.j << "}}";
+            ++written;
+        }
+    }
+    out << "\n], \"otherData\": {\"tsc_mhz\": " << ticks_per_us << ", \"overwritten\": " << overwritten
+        << ", \"lost\": " << s.lost.load(std::memory_order_relaxed) << "}}\n";
+    return out ? written : -1;
+}
+
+#endif
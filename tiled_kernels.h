@@ -0,0 +1,345 @@
+#ifndef TILED_KERNELS_H
+#define TILED_KERNELS_H
+
+// One templated family for the cache-tiled loop nests that the programs used
+// to carry as separate copies. The element type (int32_t, float, double) and
+// the tile edges are template parameters:
+//
+//     TileOperands<float> ops{A, B, C, m, n, k, lda, ldb, ldc};
+//     tiled_omp<float, 128>(ops, omp_get_max_threads());              // omp2.cpp
+//     tiled_3level_omp<float, 64, 128, 512>(ops, omp_get_max_threads());
+//
+// Every full L1 tile runs tile_full, whose loops have compile-time trip counts
+// (i-k-j order, the unit-stride j loop vectorized into a C row kept in
+// registers). Only the ragged right/bottom tiles are peeled off to tile_edge
+// with runtime bounds. All kernels compute C += A * B.
+//
+// tiled_omp_dispatch / tiled_3level_omp_dispatch run the same loop nests from
+// an AVX-512, AVX2 or baseline build chosen at startup (cpu_dispatch.h). Their
+// tile edges come from a TileConfig: the defaults measured best for that ISA,
+// or the per-machine values the tune tool stores (load_tuned_tiles,
+// autotune.h). Only the innermost edge is compiled in, as one of
+// TILE_EDGES; the L2 and L3 edges of the three-level nest are runtime bounds.
+//
+// Every C tile, and every L2 block of the three-level nest, is a
+// TileTraceScope (tile_trace.h): free while tracing is off.
+
+#include <algorithm>
+#include <type_traits>
+#include <cstddef>
+#include "cpu_dispatch.h"
+#include "tile_trace.h"
+
+// A is m x k, B is k x n and C is m x n, all row-major with row strides
+// lda >= k, ldb >= n and ldc >= n
+template <typename T>
+struct TileOperands {
+    const T *A;
+    const T *B;
+    T *C;
+    int m;
+    int n;
+    int k;
+    int lda;
+    int ldb;
+    int ldc;
+};
+
+// C[i0:i0+TI, j0:j0+TJ] += A[i0:i0+TI, k0:k0+TK] * B[k0:k0+TK, j0:j0+TJ]
+template <typename T, int TI, int TJ, int TK>
+inline void tile_full(const TileOperands<T> &ops, int i0, int j0, int k0) {
+    for (int i = 0; i < TI; ++i) {
+        const T *a = ops.A + (size_t)(i0 + i) * ops.lda + k0;
+        T *c = ops.C + (size_t)(i0 + i) * ops.ldc + j0;
+        alignas(64) T acc[TJ];
+        #pragma omp simd
+        for (int j = 0; j < TJ; ++j)
+            acc[j] = c[j];
+        for (int p = 0; p < TK; ++p) {
+            const T a_ip = a[p];
+            const T *b = ops.B + (size_t)(k0 + p) * ops.ldb + j0;
+            #pragma omp simd
+            for (int j = 0; j < TJ; ++j)
+                acc[j] += a_ip * b[j];
+        }
+        #pragma omp simd
+        for (int j = 0; j < TJ; ++j)
+            c[j] = acc[j];
+    }
+}
+
+// Same product over a ti x tj x tk remainder tile
+template <typename T>
+inline void tile_edge(const TileOperands<T> &ops, int i0, int j0, int k0, int ti, int tj, int tk) {
+    for (int i = 0; i < ti; ++i) {
+        const T *a = ops.A + (size_t)(i0 + i) * ops.lda + k0;
+        T *c = ops.C + (size_t)(i0 + i) * ops.ldc + j0;
+        for (int p = 0; p < tk; ++p) {
+            const T a_ip = a[p];
+            const T *b = ops.B + (size_t)(k0 + p) * ops.ldb + j0;
+            #pragma omp simd
+            for (int j = 0; j < tj; ++j)
+                c[j] += a_ip * b[j];
+        }
+    }
+}
+
+// TI x TJ x TK tile at (i0, j0, k0), clipped to rows < i_end and to n, k
+template <typename T, int TI, int TJ, int TK>
+inline void tile_block(const TileOperands<T> &ops, int i0, int j0, int k0, int i_end) {
+    int ti = std::min(TI, i_end - i0);
+    int tj = std::min(TJ, ops.n - j0);
+    int tk = std::min(TK, ops.k - k0);
+    if (ti == TI && tj == TJ && tk == TK)
+        tile_full<T, TI, TJ, TK>(ops, i0, j0, k0);
+    else
+        tile_edge(ops, i0, j0, k0, ti, tj, tk);
+}
+
+// One TILE x TILE tile of C at (i0, j0) over all of k
+template <typename T, int TILE>
+inline void tiled_c_tile(const TileOperands<T> &ops, int i0, int j0, int i_end) {
+    TileTraceScope trace("C tile", i0, j0);
+    for (int k0 = 0; k0 < ops.k; k0 += TILE)
+        tile_block<T, TILE, TILE, TILE>(ops, i0, j0, k0, i_end);
+}
+
+// Rows [row_begin, row_end) of C with one tile level
+template <typename T, int TILE>
+inline void tiled_rows(const TileOperands<T> &ops, int row_begin, int row_end) {
+    for (int i0 = row_begin; i0 < row_end; i0 += TILE)
+        for (int j0 = 0; j0 < ops.n; j0 += TILE)
+            tiled_c_tile<T, TILE>(ops, i0, j0, row_end);
+}
+
+// One l3 x l3 tile of C at (i3, j3) with l3/l2/L1 tile levels over all of k.
+// l2 must be a multiple of L1 and l3 of l2.
+template <typename T, int L1>
+inline void tiled_3level_c_tile(const TileOperands<T> &ops, int i3, int j3, int i_end, int l2, int l3) {
+    TileTraceScope trace("L3 tile", i3, j3);
+    const int i3_end = std::min(i3 + l3, i_end), j3_end = std::min(j3 + l3, ops.n);
+    for (int k3 = 0; k3 < ops.k; k3 += l3) {
+        const int k3_end = std::min(k3 + l3, ops.k);
+        for (int i2 = i3; i2 < i3_end; i2 += l2)
+            for (int j2 = j3; j2 < j3_end; j2 += l2) {
+                TileTraceScope trace_l2("L2 tile", i2, j2);
+                for (int k2 = k3; k2 < k3_end; k2 += l2)
+                    for (int i1 = i2; i1 < std::min(i2 + l2, i3_end); i1 += L1)
+                        for (int j1 = j2; j1 < std::min(j2 + l2, j3_end); j1 += L1)
+                            for (int k1 = k2; k1 < std::min(k2 + l2, k3_end); k1 += L1)
+                                tile_block<T, L1, L1, L1>(ops, i1, j1, k1, i3_end);
+            }
+    }
+}
+
+// Same with every edge compiled in
+template <typename T, int L1, int L2, int L3>
+inline void tiled_3level_c_tile(const TileOperands<T> &ops, int i3, int j3, int i_end) {
+    static_assert(L2 % L1 == 0 && L3 % L2 == 0, "tile levels must nest");
+    tiled_3level_c_tile<T, L1>(ops, i3, j3, i_end, L2, L3);
+}
+
+// Rows [row_begin, row_end) of C with three tile levels
+template <typename T, int L1, int L2, int L3>
+inline void tiled_3level_rows(const TileOperands<T> &ops, int row_begin, int row_end) {
+    for (int i3 = row_begin; i3 < row_end; i3 += L3)
+        for (int j3 = 0; j3 < ops.n; j3 += L3)
+            tiled_3level_c_tile<T, L1, L2, L3>(ops, i3, j3, row_end);
+}
+
+// Calls fn(i0, j0) for every TILE x TILE tile of an m x n C on an OpenMP
+// team. The dynamic schedule balances load; the static one gives a fixed
+// tile-to-thread mapping, so a first-touch pass run with the same arguments
+// places each tile's pages on the node of the thread that computes it.
+template <typename Fn>
+inline void omp_for_tiles(int tile, int m, int n, int num_threads, bool static_schedule, Fn fn) {
+    if (static_schedule) {
+        #pragma omp parallel for collapse(2) schedule(static) num_threads(num_threads)
+        for (int i0 = 0; i0 < m; i0 += tile)
+            for (int j0 = 0; j0 < n; j0 += tile)
+                fn(i0, j0);
+    } else {
+        #pragma omp parallel for collapse(2) schedule(dynamic) num_threads(num_threads)
+        for (int i0 = 0; i0 < m; i0 += tile)
+            for (int j0 = 0; j0 < n; j0 += tile)
+                fn(i0, j0);
+    }
+}
+
+template <int TILE, typename Fn>
+inline void omp_for_tiles(int m, int n, int num_threads, bool static_schedule, Fn fn) {
+    omp_for_tiles(TILE, m, n, num_threads, static_schedule, fn);
+}
+
+// OpenMP over the TILE x TILE tiles of C
+template <typename T, int TILE>
+inline void tiled_omp(const TileOperands<T> &ops, int num_threads, bool static_schedule = false) {
+    omp_for_tiles<TILE>(ops.m, ops.n, num_threads, static_schedule, [&](int i0, int j0) {
+        tiled_c_tile<T, TILE>(ops, i0, j0, ops.m);
+    });
+}
+
+// OpenMP over the L3 tiles of C, three tile levels inside each
+template <typename T, int L1, int L2, int L3>
+inline void tiled_3level_omp(const TileOperands<T> &ops, int num_threads, bool static_schedule = false) {
+    omp_for_tiles<L3>(ops.m, ops.n, num_threads, static_schedule, [&](int i3, int j3) {
+        tiled_3level_c_tile<T, L1, L2, L3>(ops, i3, j3, ops.m);
+    });
+}
+
+// Tile edges per ISA, specialized where a target differs. 128-float rows
+// (8 zmm / 16 ymm) ran 15-25% faster than 64 on single C tiles, but no
+// faster or slower in tiled_mm_vect and matmul_op at N = 2048-3200 on
+// AVX-512, AVX2 and SSE2, so every ISA keeps the 64/128/512 nest
+template <int ISA> struct IsaTiles { static const int TILE = 64, L1 = 64, L2 = 128, L3 = 512; };
+
+// Compiled-in edges for the one-level tile and the innermost level of the
+// three-level nest
+const int TILE_EDGES[] = {32, 64, 128};
+
+// Runtime tile edges: tile for the one-level nest, l1/l2/l3 for the
+// three-level one
+struct TileConfig {
+    int tile = 64;
+    int l1 = 64;
+    int l2 = 128;
+    int l3 = 512;
+};
+
+inline bool tile_edge_compiled(int edge) {
+    for (int e : TILE_EDGES)
+        if (e == edge)
+            return true;
+    return false;
+}
+
+// tile and l1 from TILE_EDGES, l2 a multiple of l1, l3 a multiple of l2
+inline bool tile_config_valid(const TileConfig &cfg) {
+    return tile_edge_compiled(cfg.tile) && tile_edge_compiled(cfg.l1) && cfg.l2 >= cfg.l1 && cfg.l2 % cfg.l1 == 0 &&
+           cfg.l3 >= cfg.l2 && cfg.l3 % cfg.l2 == 0;
+}
+
+template <int ISA>
+inline TileConfig isa_tile_config() {
+    return TileConfig{IsaTiles<ISA>::TILE, IsaTiles<ISA>::L1, IsaTiles<ISA>::L2, IsaTiles<ISA>::L3};
+}
+
+// IsaTiles of selected_isa()
+inline TileConfig default_tile_config() {
+    switch (selected_isa()) {
+    case ISA_AVX512: return isa_tile_config<ISA_AVX512>();
+    case ISA_AVX2:   return isa_tile_config<ISA_AVX2>();
+    default:         return isa_tile_config<ISA_SSE2>();
+    }
+}
+
+// Calls fn(std::integral_constant<int, edge>()) for an edge of TILE_EDGES
+// (64 for any other value), so a runtime edge picks a compiled-in nest
+template <typename Fn>
+inline void with_tile_edge(int edge, Fn fn) {
+    switch (edge) {
+    case 32:  fn(std::integral_constant<int, 32>()); break;
+    case 128: fn(std::integral_constant<int, 128>()); break;
+    default:  fn(std::integral_constant<int, 64>());
+    }
+}
+
+// Per-ISA builds of one C tile; the target attribute plus flatten compiles
+// the whole inlined tile loop nest for that ISA
+template <typename T, int TILE>
+ISA_TARGET_AVX512 void tiled_c_tile_avx512(const TileOperands<T> &ops, int i0, int j0, int i_end) {
+    tiled_c_tile<T, TILE>(ops, i0, j0, i_end);
+}
+
+template <typename T, int TILE>
+ISA_TARGET_AVX2 void tiled_c_tile_avx2(const TileOperands<T> &ops, int i0, int j0, int i_end) {
+    tiled_c_tile<T, TILE>(ops, i0, j0, i_end);
+}
+
+template <typename T, int TILE>
+ISA_TARGET_BASE void tiled_c_tile_base(const TileOperands<T> &ops, int i0, int j0, int i_end) {
+    tiled_c_tile<T, TILE>(ops, i0, j0, i_end);
+}
+
+template <typename T, int L1>
+ISA_TARGET_AVX512 void tiled_3level_c_tile_avx512(const TileOperands<T> &ops, int i3, int j3, int i_end, int l2,
+                                                  int l3) {
+    tiled_3level_c_tile<T, L1>(ops, i3, j3, i_end, l2, l3);
+}
+
+template <typename T, int L1>
+ISA_TARGET_AVX2 void tiled_3level_c_tile_avx2(const TileOperands<T> &ops, int i3, int j3, int i_end, int l2,
+                                              int l3) {
+    tiled_3level_c_tile<T, L1>(ops, i3, j3, i_end, l2, l3);
+}
+
+template <typename T, int L1>
+ISA_TARGET_BASE void tiled_3level_c_tile_base(const TileOperands<T> &ops, int i3, int j3, int i_end, int l2,
+                                              int l3) {
+    tiled_3level_c_tile<T, L1>(ops, i3, j3, i_end, l2, l3);
+}
+
+// tiled_omp with the tile kernel of selected_isa() and edge cfg.tile
+template <typename T>
+inline void tiled_omp_dispatch(const TileOperands<T> &ops, int num_threads, bool static_schedule = false,
+                               const TileConfig &cfg = default_tile_config()) {
+    with_tile_edge(cfg.tile, [&](auto edge) {
+        constexpr int TILE = decltype(edge)::value;
+        switch (selected_isa()) {
+        case ISA_AVX512:
+            omp_for_tiles<TILE>(ops.m, ops.n, num_threads, static_schedule, [&](int i0, int j0) {
+                tiled_c_tile_avx512<T, TILE>(ops, i0, j0, ops.m);
+            });
+            break;
+        case ISA_AVX2:
+            omp_for_tiles<TILE>(ops.m, ops.n, num_threads, static_schedule, [&](int i0, int j0) {
+                tiled_c_tile_avx2<T, TILE>(ops, i0, j0, ops.m);
+            });
+            break;
+        default:
+            omp_for_tiles<TILE>(ops.m, ops.n, num_threads, static_schedule, [&](int i0, int j0) {
+                tiled_c_tile_base<T, TILE>(ops, i0, j0, ops.m);
+            });
+        }
+    });
+}
+
+// tiled_3level_omp with the tile kernel of selected_isa() and edges cfg.l1/l2/l3
+template <typename T>
+inline void tiled_3level_omp_dispatch(const TileOperands<T> &ops, int num_threads, bool static_schedule = false,
+                                      const TileConfig &cfg = default_tile_config()) {
+    with_tile_edge(cfg.l1, [&](auto edge) {
+        constexpr int L1 = decltype(edge)::value;
+        switch (selected_isa()) {
+        case ISA_AVX512:
+            omp_for_tiles(cfg.l3, ops.m, ops.n, num_threads, static_schedule, [&](int i3, int j3) {
+                tiled_3level_c_tile_avx512<T, L1>(ops, i3, j3, ops.m, cfg.l2, cfg.l3);
+            });
+            break;
+        case ISA_AVX2:
+            omp_for_tiles(cfg.l3, ops.m, ops.n, num_threads, static_schedule, [&](int i3, int j3) {
+                tiled_3level_c_tile_avx2<T, L1>(ops, i3, j3, ops.m, cfg.l2, cfg.l3);
+            });
+            break;
+        default:
+            omp_for_tiles(cfg.l3, ops.m, ops.n, num_threads, static_schedule, [&](int i3, int j3) {
+                tiled_3level_c_tile_base<T, L1>(ops, i3, j3, ops.m, cfg.l2, cfg.l3);
+            });
+        }
+    });
+}
+
+// Sets every element of the tile x tile tile at (i0, j0) of a rows x cols
+// matrix with row stride ld
+template <typename T>
+inline void fill_tile(T *mat, int rows, int cols, int ld, int i0, int j0, int tile, T value) {
+    for (int i = i0; i < std::min(i0 + tile, rows); ++i)
+        std::fill(mat + (size_t)i * ld + j0, mat + (size_t)i * ld + std::min(j0 + tile, cols), value);
+}
+
+template <typename T, int TILE>
+inline void fill_tile(T *mat, int rows, int cols, int ld, int i0, int j0, T value) {
+    fill_tile(mat, rows, cols, ld, i0, j0, TILE, value);
+}
+
+#endif
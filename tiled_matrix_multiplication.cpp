@@ -2,82 +2,101 @@
 #include <vector>
 #include <thread>
 #include <chrono>
-#include <mutex>
-
-std::mutex io_mutex;
+#include <algorithm>
+#include "perf_counters.h"
+#include "thread_pool.h"
+#include "tiled_kernels.h"
+#include "tile_trace.h"
+#include "matrix.h"
+#include "numa.h"
+#include "team_plan.h"
 
 const int N = 3200;        // Matrix size
 const int TILE_SIZE = 128;  // Tile size
-const int NUM_THREADS = std::thread::hardware_concurrency();
-
-using Matrix = std::vector<std::vector<float>>;
 
-// Initialization of the matrix with fixed values for reproducibility
-void initialize_matrix(Matrix &mat, float value) {
-    for (int i = 0; i < N; ++i)
-        for (int j = 0; j < N; ++j)
-            mat[i][j] = value;
-}
+using Matrix = DenseMatrix<float>;  // One aligned, padded, huge-page buffer; untouched until initialized
 
-// Tiled matrix multiplication for a specific row range
-void tiled_multiply_worker(const Matrix &A, const Matrix &B, Matrix &C, int row_start, int row_end) {
-    {
-        std::lock_guard<std::mutex> lock(io_mutex);
-        std::cout << "Thread " << std::this_thread::get_id()
-                  << " started: rows " << row_start << " to " << row_end - 1 << std::endl;
-    }
-    for (int i = row_start; i < row_end; i += TILE_SIZE) {
-        for (int j = 0; j < N; j += TILE_SIZE) {
-            for (int k = 0; k < N; k += TILE_SIZE) {
-                for (int ii = i; ii < std::min(i + TILE_SIZE, row_end); ++ii) {
-                    for (int jj = j; jj < std::min(j + TILE_SIZE, N); ++jj) {
-                        float sum = C[ii][jj];
-                        for (int kk = k; kk < std::min(k + TILE_SIZE, N); ++kk) {
-                            sum += A[ii][kk] * B[kk][jj];
-                        }
-                        C[ii][jj] = sum;
-                    }
-                }
-            }
-        }
-    }
-    {
-        std::lock_guard<std::mutex> lock(io_mutex);
-        std::cout << "Thread " << std::this_thread::get_id() << " finished.\n";
+// Initialization of the matrix with fixed values for reproducibility. In NUMA
+// mode every tile is written by the worker it is dealt to, so its pages are
+// allocated on the node of the thread that will compute it.
+void initialize_matrix(Matrix &mat, float value, WorkStealingPool &pool, const NumaOptions &numa) {
+    if (!numa.enabled()) {
+        mat.fill(value);
+        return;
     }
+    int tiles = (N + TILE_SIZE - 1) / TILE_SIZE;
+    pool.run_tiles(tiles, tiles, [&](int ti, int tj) {
+        fill_tile<float, TILE_SIZE>(mat.data(), N, N, mat.ld(), ti * TILE_SIZE, tj * TILE_SIZE, value);
+    }, false);
 }
 
-//Multithreading
-void tiled_matrix_multiply(const Matrix &A, const Matrix &B, Matrix &C) {
-    std::vector<std::thread> threads;
-    int rows_per_thread = N / NUM_THREADS; //distributes among the available threads
+// Tiled matrix multiplication of the C tile starting at (i, j)
+void tiled_multiply_tile(const Matrix &A, const float *B, int ldb, Matrix &C, int i, int j) {
+    TileOperands<float> ops{A.data(), B, C.data(), C.rows(), C.cols(), N, A.ld(), ldb, C.ld()};
+    tiled_c_tile<float, TILE_SIZE>(ops, i, j, C.rows());
+}
 
-    for (int t = 0; t < NUM_THREADS; ++t) { //spawn threads
-        int row_start = t * rows_per_thread;
-        int row_end = (t == NUM_THREADS - 1) ? N : row_start + rows_per_thread;
-        threads.emplace_back(tiled_multiply_worker, std::ref(A), std::ref(B), std::ref(C), row_start, row_end);
-    }
+// Seconds of one C tile on scratch operands shaped like it (TILE_SIZE x N
+// times N x TILE_SIZE), for plan_team
+double tile_seconds() {
+    Matrix a(TILE_SIZE, N, 1.0f), b(N, TILE_SIZE, 2.0f), c(TILE_SIZE, TILE_SIZE, 0.0f);
+    return time_best([&] { tiled_multiply_tile(a, b.data(), b.ld(), c, 0, 0); });
+}
 
-    for (auto &thread : threads) //wait for all threads
-        thread.join();
+//Multithreading: C tiles are dealt to the pool's deques and stolen by idle threads
+void tiled_matrix_multiply(const Matrix &A, const NumaReplicas<float> &B, int ldb, Matrix &C,
+                           WorkStealingPool &pool) {
+    int tiles = (N + TILE_SIZE - 1) / TILE_SIZE;
+    pool.run_tiles(tiles, tiles, [&](int ti, int tj) {
+        tiled_multiply_tile(A, B.local(), ldb, C, ti * TILE_SIZE, tj * TILE_SIZE);
+    });
 }
 
 int main() {
-    Matrix A(N, std::vector<float>(N));
-    Matrix B(N, std::vector<float>(N));
-    Matrix C(N, std::vector<float>(N, 0));
+    // Pool size from this kernel's measured tile time: the whole machine only
+    // when the product is big enough to pay for it
+    const int tiles = (N + TILE_SIZE - 1) / TILE_SIZE;
+    const int num_threads =
+        plan_team(tiles * tiles, tile_seconds(), std::max(1u, std::thread::hardware_concurrency())).num_threads;
+    NumaOptions numa = numa_options_from_env();
+    WorkStealingPool pool(num_threads);
+    if (numa.enabled()) {
+        std::vector<cpu_set_t> plan = pin_plan(numa_topology(), numa.pin, num_threads);
+        pool.run_on_each_thread([&](int id) { pin_current_thread(plan[id]); });
+    }
+
+    Matrix A(N, N);
+    Matrix B(N, N);
+    Matrix C(N, N);
+
+    initialize_matrix(A, 1.0f, pool, numa);
+    initialize_matrix(B, 2.0f, pool, numa);
+    initialize_matrix(C, 0.0f, pool, numa);
 
-    initialize_matrix(A, 1.0f);
-    initialize_matrix(B, 2.0f);
+    NumaReplicas<float> B_local(B.data(), B.size(), numa.replicate_b);
+    if (numa.replicate_b)
+        pool.run_on_each_thread([&](int) { B_local.populate(); });
 
+    const char *trace_path = tile_trace_from_env();    // TILE_TRACE=trace.json records the tile timeline
+    PerfCounters counters;
+    counters.start();
+    pool.run_on_each_thread([&](int) { counters.attach_current_thread(); });
     auto start = std::chrono::high_resolution_clock::now();
-    tiled_matrix_multiply(A, B, C);
+    tiled_matrix_multiply(A, B_local, B.ld(), C, pool);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     std::chrono::duration<double> elapsed = end - start;
     std::cout << "Matrix multiplication completed in " << elapsed.count() << " seconds.\n";
 
-    std::cout << "Detected hardware threads: " << NUM_THREADS << std::endl;
+    std::cout << "Threads used: " << num_threads << " of " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "Tiles stolen: " << pool.steals() << std::endl;
+    if (numa.enabled())
+        std::cout << "NUMA nodes: " << numa_topology().num_nodes() << ", pinning: " << pin_policy_name(numa.pin)
+                  << ", B replicated: " << (B_local.replicated() ? "yes" : "no") << std::endl;
+    if (trace_path)
+        std::cout << "Tile trace: " << tile_trace_write(trace_path) << " events written to " << trace_path << std::endl;
+    counters.report(std::cout, 2.0 * N * N * N);
 
     return 0;
 }
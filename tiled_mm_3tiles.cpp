@@ -2,104 +2,80 @@
 #include <vector>
 #include <thread>
 #include <chrono>
-#include <mutex>
 #include <algorithm>
-
-std::mutex io_mutex;
+#include "perf_counters.h"
+#include "autotune.h"
+#include "thread_pool.h"
+#include "tiled_kernels.h"
+#include "tile_trace.h"
+#include "matrix.h"
+#include "team_plan.h"
 
 const int N = 3200;        // Matrix size
-const int TILE_L1 = 64;    // Fits in L1 cache of size 160 KB
-const int TILE_L2 = 128;   // Fits in L2 cache of size 2.5 MB
-const int TILE_L3 = 512;   // Fits in L3 cache of size 6.0 MB
-const int NUM_THREADS = std::thread::hardware_concurrency();
 
-using Matrix = std::vector<std::vector<float>>;
+// Tile edges tuned for this CPU by ./tune, else the ISA defaults (64/128/512)
+const TileConfig tiles = tuned_tile_config();
+
+using Matrix = DenseMatrix<float>;  // One aligned, padded, huge-page buffer
 
 // Initialize matrices with a constant value
 void initialize_matrix(Matrix &mat, float value) {
-    for (int i = 0; i < N; ++i)
-        for (int j = 0; j < N; ++j)
-            mat[i][j] = value;
+    mat.fill(value);
 }
 
-// 3-level tiled matrix multiplication per thread
-void tiled_multiply_worker(const Matrix &A, const Matrix &B, Matrix &C, int row_start, int row_end) {
-    {
-        std::lock_guard<std::mutex> lock(io_mutex);
-        std::cout << "Thread " << std::this_thread::get_id()
-                  << " started: rows " << row_start << " to " << row_end - 1 << std::endl;
-    }
-
-    for (int i3 = row_start; i3 < row_end; i3 += TILE_L3) {
-        for (int j3 = 0; j3 < N; j3 += TILE_L3) {
-            for (int k3 = 0; k3 < N; k3 += TILE_L3) {
-
-                for (int i2 = i3; i2 < std::min(i3 + TILE_L3, row_end); i2 += TILE_L2) {
-                    for (int j2 = j3; j2 < std::min(j3 + TILE_L3, N); j2 += TILE_L2) {
-                        for (int k2 = k3; k2 < std::min(k3 + TILE_L3, N); k2 += TILE_L2) {
-
-                            for (int i1 = i2; i1 < std::min(i2 + TILE_L2, row_end); i1 += TILE_L1) {
-                                for (int j1 = j2; j1 < std::min(j2 + TILE_L2, N); j1 += TILE_L1) {
-                                    for (int k1 = k2; k1 < std::min(k2 + TILE_L2, N); k1 += TILE_L1) {
-
-                                        for (int i = i1; i < std::min(i1 + TILE_L1, row_end); ++i) {
-                                            for (int j = j1; j < std::min(j1 + TILE_L1, N); ++j) {
-                                                float sum = C[i][j];
-                                                for (int k = k1; k < std::min(k1 + TILE_L1, N); ++k) {
-                                                    sum += A[i][k] * B[k][j];
-                                                }
-                                                C[i][j] = sum;
-                                            }
-                                        }
-
-                                    }
-                                }
-                            }
-
-                        }
-                    }
-                }
-
-            }
-        }
-    }
-
-    {
-        std::lock_guard<std::mutex> lock(io_mutex);
-        std::cout << "Thread " << std::this_thread::get_id() << " finished.\n";
-    }
+// 3-level tiled matrix multiplication of the L3 tile of C starting at (i3, j3)
+void tiled_multiply_tile(const Matrix &A, const Matrix &B, Matrix &C, int i3, int j3) {
+    TileOperands<float> ops{A.data(), B.data(), C.data(), C.rows(), C.cols(), N, A.ld(), B.ld(), C.ld()};
+    with_tile_edge(tiles.l1, [&](auto l1) {
+        tiled_3level_c_tile<float, decltype(l1)::value>(ops, i3, j3, C.rows(), tiles.l2, tiles.l3);
+    });
 }
 
-// Spawns threads
-void tiled_matrix_multiply(const Matrix &A, const Matrix &B, Matrix &C) {
-    std::vector<std::thread> threads;
-    int rows_per_thread = N / NUM_THREADS;
-
-    for (int t = 0; t < NUM_THREADS; ++t) {
-        int row_start = t * rows_per_thread;
-        int row_end = (t == NUM_THREADS - 1) ? N : row_start + rows_per_thread;
-        threads.emplace_back(tiled_multiply_worker, std::ref(A), std::ref(B), std::ref(C), row_start, row_end);
-    }
+// Seconds of one L3 tile on scratch operands shaped like it, for plan_team
+double l3_tile_seconds() {
+    Matrix a(tiles.l3, N, 1.0f), b(N, tiles.l3, 2.0f), c(tiles.l3, tiles.l3, 0.0f);
+    return time_best([&] { tiled_multiply_tile(a, b, c, 0, 0); });
+}
 
-    for (auto &thread : threads)
-        thread.join();
+// L3 tiles are dealt to the pool's deques and stolen by idle threads
+void tiled_matrix_multiply(const Matrix &A, const Matrix &B, Matrix &C, WorkStealingPool &pool) {
+    int l3_tiles = (N + tiles.l3 - 1) / tiles.l3;
+    pool.run_tiles(l3_tiles, l3_tiles, [&](int ti, int tj) {
+        tiled_multiply_tile(A, B, C, ti * tiles.l3, tj * tiles.l3);
+    });
 }
 
 int main() {
-    Matrix A(N, std::vector<float>(N));
-    Matrix B(N, std::vector<float>(N));
-    Matrix C(N, std::vector<float>(N, 0));
+    Matrix A(N, N);
+    Matrix B(N, N);
+    Matrix C(N, N, 0.0f);
 
     initialize_matrix(A, 1.0f);
     initialize_matrix(B, 2.0f);
 
+    // Pool size from this kernel's measured L3 tile time, never more threads than L3 tiles
+    const int l3_tiles = (N + tiles.l3 - 1) / tiles.l3;
+    const int hw = std::max(1u, std::thread::hardware_concurrency());
+    const int num_threads = plan_team(l3_tiles * l3_tiles, l3_tile_seconds(), hw).num_threads;
+    WorkStealingPool pool(num_threads);
+
+    const char *trace_path = tile_trace_from_env();    // TILE_TRACE=trace.json records the tile timeline
+    PerfCounters counters;
+    counters.start();
+    pool.run_on_each_thread([&](int) { counters.attach_current_thread(); });
     auto start = std::chrono::high_resolution_clock::now();
-    tiled_matrix_multiply(A, B, C);
+    tiled_matrix_multiply(A, B, C, pool);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     std::chrono::duration<double> elapsed = end - start;
     std::cout << "Matrix multiplication completed in " << elapsed.count() << " seconds.\n";
-    std::cout << "Detected hardware threads: " << NUM_THREADS << std::endl;
+    std::cout << "Threads used: " << num_threads << " of " << std::thread::hardware_concurrency() << std::endl;
+    std::cout << "Tiles: " << tiles.l1 << "/" << tiles.l2 << "/" << tiles.l3 << std::endl;
+    std::cout << "Tiles stolen: " << pool.steals() << std::endl;
+    if (trace_path)
+        std::cout << "Tile trace: " << tile_trace_write(trace_path) << " events written to " << trace_path << std::endl;
+    counters.report(std::cout, 2.0 * N * N * N);
 
     return 0;
 }
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+#include "gemm.h"
+#include "matrix.h"
+#include "rng.h"
+#include "perf_counters.h"
+
+// Many independent small products through sgemm_batch_strided, against a
+// plain loop of sgemm calls on the same data.
+// Usage: ./tiled_mm_batch [size [batch]]   (defaults to 16 x 16 x 16, 100000 products)
+
+// Max abs error of a few sampled entries, recomputed in double
+static double sampled_error(const DenseMatrix<float> &A, const DenseMatrix<float> &B,
+                            const DenseMatrix<float> &C, int s, int batch) {
+    double max_err = 0.0;
+    for (int b = 0; b < batch; b += std::max(1, batch / 16))
+        for (int i = 0; i < s; ++i)
+            for (int j = 0; j < s; ++j) {
+                double sum = 0.0;
+                for (int p = 0; p < s; ++p)
+                    sum += (double)A(b * s + i, p) * B(b * s + p, j);
+                max_err = std::max(max_err, std::fabs(sum - C(b * s + i, j)));
+            }
+    return max_err;
+}
+
+int main(int argc, char **argv) {
+    int s = 16, batch = 100000;
+    if (argc >= 2)
+        s = std::atoi(argv[1]);
+    if (argc >= 3)
+        batch = std::atoi(argv[2]);
+    if (s <= 0 || batch <= 0) {
+        std::cerr << "Usage: ./tiled_mm_batch [size [batch]]" << std::endl;
+        return -1;
+    }
+
+    // Entry b of each batch is rows [b*s, b*s + s) of one tall matrix, unpadded:
+    // a 4-float row padded to a cache line would quadruple the bytes streamed
+    DenseMatrix<float> A(batch * s, s, false), B(batch * s, s, false), C(batch * s, s, 0.0f, false);
+    philox_fill_int(A, 1, 0, 9);
+    philox_fill_int(B, 2, 0, 9);
+    const ptrdiff_t stride_a = (ptrdiff_t)s * A.ld(), stride_b = (ptrdiff_t)s * B.ld(),
+                    stride_c = (ptrdiff_t)s * C.ld();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int b = 0; b < batch; ++b)
+        sgemm('N', 'N', s, s, s, 1.0f, A.data() + b * stride_a, A.ld(), B.data() + b * stride_b, B.ld(),
+              0.0f, C.data() + b * stride_c, C.ld());
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> loop = end - start;
+
+    PerfCounters counters;
+    counters.start();
+    start = std::chrono::high_resolution_clock::now();
+    int info = sgemm_batch_strided('N', 'N', s, s, s, 1.0f, A.data(), A.ld(), stride_a, B.data(), B.ld(), stride_b,
+                                   0.0f, C.data(), C.ld(), stride_c, batch);
+    end = std::chrono::high_resolution_clock::now();
+    counters.stop();
+    std::chrono::duration<double> batched = end - start;
+
+    if (info != 0) {
+        std::cerr << "sgemm_batch_strided: invalid argument " << -info << std::endl;
+        return -1;
+    }
+
+    double flops = 2.0 * s * s * (double)s * batch;
+    std::cout << batch << " products of " << s << " x " << s << " x " << s << "\n";
+    std::cout << "sgemm loop:   " << loop.count() << " s, " << batch / loop.count() << " GEMM/s, "
+              << flops / loop.count() * 1e-9 << " GFLOP/s\n";
+    std::cout << "sgemm_batch:  " << batched.count() << " s, " << batch / batched.count() << " GEMM/s, "
+              << flops / batched.count() * 1e-9 << " GFLOP/s\n";
+    std::cout << "Max abs error: " << sampled_error(A, B, C, s, batch) << "\n";
+    std::cout << "OpenMP threads used: " << omp_get_max_threads() << std::endl;
+    counters.report(std::cout, flops, true);
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+#include "gemm.h"
+#include "matrix.h"
+#include "rng.h"
+#include "matrix_chain.h"
+
+// Product of a matrix chain in the order the code happens to write it (left
+// to right, one sgemm after another) and through chain_multiply.
+// Usage: ./tiled_mm_chain [d0 d1 ... dn]   (matrix t is dt x dt+1; defaults to 3000 40 2500 60 3000 50)
+
+template <typename F>
+static double seconds(F run) {
+    auto start = std::chrono::high_resolution_clock::now();
+    run();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+    std::vector<int> dims{3000, 40, 2500, 60, 3000, 50};
+    if (argc >= 3) {
+        dims.clear();
+        for (int a = 1; a < argc; ++a)
+            dims.push_back(std::atoi(argv[a]));
+    }
+    if (dims.size() < 2 || *std::min_element(dims.begin(), dims.end()) <= 0) {
+        std::cerr << "Usage: ./tiled_mm_chain [d0 d1 ... dn]" << std::endl;
+        return -1;
+    }
+    const int n = (int)dims.size() - 1;
+
+    std::vector<DenseMatrix<float>> mats;
+    std::vector<const DenseMatrix<float> *> chain;
+    for (int t = 0; t < n; ++t) {
+        mats.emplace_back(dims[t], dims[t + 1]);
+        philox_fill_uniform(mats.back(), t + 1, -1.0f, 1.0f);
+    }
+    for (const DenseMatrix<float> &m : mats)
+        chain.push_back(&m);
+
+    // Left to right, temporaries allocated up front
+    std::vector<DenseMatrix<float>> partial;
+    for (int t = 1; t < n; ++t)
+        partial.emplace_back(dims[0], dims[t + 1]);
+    double t_naive = seconds([&] {
+        const DenseMatrix<float> *left = &mats[0];
+        for (int t = 1; t < n; ++t) {
+            DenseMatrix<float> &out = partial[t - 1];
+            sgemm('N', 'N', dims[0], dims[t + 1], dims[t], 1.0f, left->data(), left->ld(), mats[t].data(),
+                  mats[t].ld(), 0.0f, out.data(), out.ld());
+            left = &out;
+        }
+    });
+
+    DenseMatrix<float> result(dims[0], dims[n]);
+    ChainWorkspace ws;
+    ChainPlan plan;
+    try {
+        ws.reserve(chain_plan(dims));   // outside the timed region
+        double t_chain = seconds([&] { plan = chain_multiply(chain, result, ws); });
+
+        const DenseMatrix<float> &expect = n > 1 ? partial.back() : mats[0];
+        double max_err = 0.0, max_abs = 0.0;
+        for (int i = 0; i < result.rows(); ++i)
+            for (int j = 0; j < result.cols(); ++j) {
+                max_err = std::max(max_err, (double)std::fabs(result(i, j) - expect(i, j)));
+                max_abs = std::max(max_abs, (double)std::fabs(expect(i, j)));
+            }
+
+        std::cout << n << " matrices, order " << chain_order(plan) << "\n";
+        std::cout << "left to right:  " << t_naive << " s, " << plan.left_to_right_flops * 1e-9 << " GFLOP\n";
+        std::cout << "chain_multiply: " << t_chain << " s, " << plan.flops * 1e-9 << " GFLOP ("
+                  << ws.bytes() / 1e6 << " MB workspace)\n";
+        std::cout << "Max abs difference: " << max_err << " (max |C| " << max_abs << ")\n";
+        std::cout << "OpenMP threads used: " << omp_get_max_threads() << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <omp.h>
+#include "gemm.h"
+#include "matrix.h"
+#include "rng.h"
+
+// sgemm across the size range: square products from 32 to 2048, skinny ones,
+// matrix-vector (n = 1, m = 1) and rank-1 (k = 1) shapes. Each shape runs
+// once with the plan sgemm picks (path, threads, schedule, row block) and
+// once with the whole team forced, i.e. with a cost model that sees no
+// fork/join cost, as every call was run before.
+// Usage: ./tiled_mm_dispatch [reps]
+
+// Best-of-reps seconds of fn
+template <typename Fn>
+static double seconds(int reps, Fn fn) {
+    fn();
+    double best = 1e30;
+    for (int r = 0; r < reps; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char **argv) {
+    int reps = argc > 1 ? std::atoi(argv[1]) : 5;
+    if (reps <= 0) {
+        std::cerr << "Usage: ./tiled_mm_dispatch [reps]" << std::endl;
+        return -1;
+    }
+
+    struct Shape {
+        int m, n, k;
+    };
+    const std::vector<Shape> shapes = {
+        {32, 32, 32},     {64, 64, 64},     {128, 128, 128},  {256, 256, 256},
+        {512, 512, 512},  {2048, 2048, 2048},
+        {64, 4096, 64},   {4096, 64, 256},  {16, 16, 100000},
+        {8192, 1, 8192},  {1, 8192, 8192},  {8192, 8192, 1},
+    };
+
+    const GemmCostModel model = gemm_get_cost_model();
+    GemmCostModel full_team = model;
+    full_team.fork_join_us = 0.0;
+    full_team.socket_gflops = 1e9;
+    full_team.socket_gbs = 1e9;
+
+    std::cout << "Cost model: fork/join " << model.fork_join_us << " us, sgemm " << model.core_gflops
+              << " GFLOP/s per thread, " << model.socket_gflops << " GFLOP/s all threads, read " << model.core_gbs
+              << " GB/s per thread, " << model.socket_gbs << " GB/s all threads\n\n";
+    // A space before every column keeps wide values from running together
+    std::cout << std::setw(20) << "m x n x k" << " " << std::setw(8) << "path" << " " << std::setw(7) << "threads"
+              << " " << std::setw(7) << "sched" << " " << std::setw(5) << "mc" << " " << std::setw(11) << "planned ms"
+              << " " << std::setw(12) << "full team ms" << " " << std::setw(9) << "GFLOP/s" << " " << std::setw(8)
+              << "GB/s" << "\n";
+
+    for (const Shape &s : shapes) {
+        DenseMatrix<float> A(s.m, s.k), B(s.k, s.n), C(s.m, s.n, 0.0f);
+        philox_fill_uniform(A, 1, -1.0f, 1.0f);
+        philox_fill_uniform(B, 2, -1.0f, 1.0f);
+        auto run = [&] {
+            sgemm('N', 'N', s.m, s.n, s.k, 1.0f, A.data(), A.ld(), B.data(), B.ld(), 0.0f, C.data(), C.ld());
+        };
+
+        gemm_set_cost_model(model);
+        const GemmPlan plan = gemm_plan(s.m, s.n, s.k);
+        const double planned = seconds(reps, run);
+        gemm_set_cost_model(full_team);
+        const double forced = seconds(reps, run);
+
+        const double flops = 2.0 * s.m * s.n * (double)s.k;
+        const double bytes = sizeof(float) * ((double)s.m * s.k + (double)s.k * s.n + (double)s.m * s.n);
+        std::cout << std::setw(20) << (std::to_string(s.m) + " x " + std::to_string(s.n) + " x " + std::to_string(s.k))
+                  << " " << std::setw(8) << gemm_shape_name(plan.shape) << " " << std::setw(7) << plan.num_threads
+                  << " " << std::setw(7) << (plan.schedule == GEMM_SCHEDULE_STATIC ? "static" : "dynamic")
+                  << " " << std::setw(5) << plan.mc << std::fixed << std::setprecision(3) << " " << std::setw(11)
+                  << planned * 1e3 << " " << std::setw(12) << forced * 1e3 << std::setprecision(1) << " "
+                  << std::setw(9) << flops / planned * 1e-9 << " " << std::setw(8) << bytes / planned * 1e-9
+                  << std::defaultfloat << "\n";
+    }
+    gemm_set_cost_model(model);
+
+    std::cout << "\nOpenMP threads used: up to " << omp_get_max_threads() << std::endl;
+    return 0;
+}
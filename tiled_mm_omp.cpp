@@ -3,74 +3,108 @@
 #include <chrono>
 #include <omp.h>
 #include <algorithm>
+#include <string>
+#include <cstdlib>
+#include "perf_counters.h"
+#include "tiled_kernels.h"
+#include "tile_trace.h"
+#include "matrix.h"
+#include "numa.h"
+#include "strassen.h"
+#include "autotune.h"
 
 const int N = 4096;         // Matrix size
-const int TILE_L1 = 64;     // L1 tile
-const int TILE_L2 = 128;    // L2 tile
-const int TILE_L3 = 512;    // L3 tile
 
-using Matrix = std::vector<std::vector<float>>;
+// Tile edges tuned for this CPU by ./tune, else the ISA defaults (64/128/512)
+const TileConfig tiles = tuned_tile_config();
 
-// Initialize matrices with a constant value
-void initialize_matrix(Matrix &mat, float value) {
-    for (int i = 0; i < N; ++i)
-        for (int j = 0; j < N; ++j)
-            mat[i][j] = value;
-}
+// Usage: ./tiled_mm_omp [--strassen [crossover]]
+// --strassen recurses with Strassen-Winograd down to crossover (default 512)
+// and runs the blocks below it on the same 3-level kernel.
+
+using Matrix = DenseMatrix<float>;  // One aligned, padded, huge-page buffer; untouched until initialized
 
-// 3-level tiled matrix multiplication using OpenMP
-void tiled_matrix_multiply(const Matrix &A, const Matrix &B, Matrix &C) {
-    #pragma omp parallel for collapse(2) schedule(dynamic)
-    for (int i3 = 0; i3 < N; i3 += TILE_L3) {
-        for (int j3 = 0; j3 < N; j3 += TILE_L3) {
-            for (int k3 = 0; k3 < N; k3 += TILE_L3) {
+// Initialize a matrix with a constant value. In NUMA mode every tile is
+// written by the thread that computes the matching C tile, so its pages
+// are allocated on that thread's node.
+void initialize_matrix(Matrix &mat, float value, const NumaOptions &numa) {
+    if (!numa.enabled()) {
+        mat.fill(value);
+        return;
+    }
+    omp_for_tiles(tiles.l3, N, N, omp_get_max_threads(), true, [&](int i3, int j3) {
+        fill_tile(mat.data(), N, N, mat.ld(), i3, j3, tiles.l3, value);
+    });
+}
 
-                for (int i2 = i3; i2 < std::min(i3 + TILE_L3, N); i2 += TILE_L2) {
-                    for (int j2 = j3; j2 < std::min(j3 + TILE_L3, N); j2 += TILE_L2) {
-                        for (int k2 = k3; k2 < std::min(k3 + TILE_L3, N); k2 += TILE_L2) {
+// 3-level tiled matrix multiplication using OpenMP. NUMA mode uses the static
+// schedule of the first-touch pass and reads B from the local node's replica.
+void tiled_matrix_multiply(const Matrix &A, const NumaReplicas<float> &B, int ldb, Matrix &C,
+                           const NumaOptions &numa) {
+    with_tile_edge(tiles.l1, [&](auto l1) {
+        omp_for_tiles(tiles.l3, N, N, omp_get_max_threads(), numa.enabled(), [&](int i3, int j3) {
+            TileOperands<float> ops{A.data(), B.local(), C.data(), N, N, N, A.ld(), ldb, C.ld()};
+            tiled_3level_c_tile<float, decltype(l1)::value>(ops, i3, j3, N, tiles.l2, tiles.l3);
+        });
+    });
+}
 
-                            for (int i1 = i2; i1 < std::min(i2 + TILE_L2, N); i1 += TILE_L1) {
-                                for (int j1 = j2; j1 < std::min(j2 + TILE_L2, N); j1 += TILE_L1) {
-                                    for (int k1 = k2; k1 < std::min(k2 + TILE_L2, N); k1 += TILE_L1) {
+int main(int argc, char **argv) {
+    bool strassen = argc >= 2 && std::string(argv[1]) == "--strassen";
+    int crossover = argc >= 3 ? std::atoi(argv[2]) : STRASSEN_CROSSOVER;
+    if ((argc >= 2 && !strassen) || crossover <= 0) {
+        std::cerr << "Usage: ./tiled_mm_omp [--strassen [crossover]]" << std::endl;
+        return -1;
+    }
 
-                                        for (int i = i1; i < std::min(i1 + TILE_L1, N); ++i) {
-                                            for (int j = j1; j < std::min(j1 + TILE_L1, N); ++j) {
-                                                float sum = C[i][j];
-                                                for (int k = k1; k < std::min(k1 + TILE_L1, N); ++k) {
-                                                    sum += A[i][k] * B[k][j];
-                                                }
-                                                C[i][j] = sum;
-                                            }
-                                        }
+    NumaOptions numa = numa_options_from_env();
+    pin_omp_team(numa.pin, omp_get_max_threads());
 
-                                    }
-                                }
-                            }
+    Matrix A(N, N);
+    Matrix B(N, N);
+    Matrix C(N, N);
 
-                        }
-                    }
-                }
+    initialize_matrix(A, 1.0f, numa);
+    initialize_matrix(B, 2.0f, numa);
+    initialize_matrix(C, 0.0f, numa);
 
-            }
-        }
+    NumaReplicas<float> B_local(B.data(), B.size(), numa.replicate_b);
+    if (numa.replicate_b) {
+        #pragma omp parallel
+        B_local.populate();
     }
-}
-
-int main() {
-    Matrix A(N, std::vector<float>(N));
-    Matrix B(N, std::vector<float>(N));
-    Matrix C(N, std::vector<float>(N, 0));
 
-    initialize_matrix(A, 1.0f);
-    initialize_matrix(B, 2.0f);
+    // The workspace is sized and mapped before the timed region
+    StrassenWorkspace workspace(crossover);
+    if (strassen)
+        workspace.reserve(N, N, N);
 
+    const char *trace_path = tile_trace_from_env();    // TILE_TRACE=trace.json records the tile timeline
+    PerfCounters counters;
+    counters.start();
     auto start = std::chrono::high_resolution_clock::now();
-    tiled_matrix_multiply(A, B, C);
+    if (strassen)
+        strassen_multiply(TileOperands<float>{A.data(), B.data(), C.data(), N, N, N, A.ld(), B.ld(), C.ld()},
+                          workspace);
+    else
+        tiled_matrix_multiply(A, B_local, B.ld(), C, numa);
     auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
 
     std::chrono::duration<double> elapsed = end - start;
     std::cout << "Matrix multiplication completed in " << elapsed.count() << " seconds.\n";
-    std::cout << "OpenMP threads used: " << omp_get_max_threads() << std::endl;
+    std::cout << "OpenMP threads used: " << omp_get_max_threads() << ", tiles: " << tiles.l1 << "/" << tiles.l2
+              << "/" << tiles.l3 << std::endl;
+    if (strassen)
+        std::cout << "Strassen-Winograd: crossover " << crossover << ", task levels " << workspace.task_depth()
+                  << ", workspace " << workspace.bytes() / (1 << 20) << " MB, C[0][0] = " << C(0, 0)
+                  << " (expected " << 2.0f * N << ")" << std::endl;
+    if (numa.enabled())
+        std::cout << "NUMA nodes: " << numa_topology().num_nodes() << ", pinning: " << pin_policy_name(numa.pin)
+                  << ", B replicated: " << (B_local.replicated() ? "yes" : "no") << std::endl;
+    if (trace_path)
+        std::cout << "Tile trace: " << tile_trace_write(trace_path) << " events written to " << trace_path << std::endl;
+    counters.report(std::cout, 2.0 * N * N * N, true);
 
     return 0;
 }
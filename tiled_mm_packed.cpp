@@ -0,0 +1,80 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <omp.h>
+#include <algorithm>
+#include <string>
+#include "gemm.h"
+#include "perf_counters.h"
+#include "matrix.h"
+
+// Usage: ./tiled_mm_packed [M N K [f32|bf16|f16]]   (defaults to 4096^3 in f32)
+// bf16/f16 store A and B in 16 bits and accumulate in fp32.
+
+// Row-by-row conversion, since the 16-bit copy has its own padded stride
+template <typename T, typename Convert>
+static DenseMatrix<T> convert_matrix(const DenseMatrix<float> &src, Convert convert) {
+    DenseMatrix<T> dst(src.rows(), src.cols());
+    for (int i = 0; i < src.rows(); ++i)
+        convert(src.row(i), dst.row(i), (size_t)src.cols());
+    return dst;
+}
+
+int main(int argc, char **argv) {
+    int M = 4096, N = 4096, K = 4096;
+    std::string precision = "f32";
+    if (argc >= 4) {
+        M = std::atoi(argv[1]);
+        N = std::atoi(argv[2]);
+        K = std::atoi(argv[3]);
+    }
+    if (argc >= 5)
+        precision = argv[4];
+    if (precision != "f32" && precision != "bf16" && precision != "f16") {
+        std::cerr << "Usage: ./tiled_mm_packed [M N K [f32|bf16|f16]]" << std::endl;
+        return -1;
+    }
+
+    DenseMatrix<float> A(M, K, 1.0f);
+    DenseMatrix<float> B(K, N, 2.0f);
+    DenseMatrix<float> C(M, N, 0.0f);
+    DenseMatrix<bf16_t> A_bf16, B_bf16;
+    DenseMatrix<fp16_t> A_f16, B_f16;
+    if (precision == "bf16") {
+        A_bf16 = convert_matrix<bf16_t>(A, gemm_float_to_bf16);
+        B_bf16 = convert_matrix<bf16_t>(B, gemm_float_to_bf16);
+    } else if (precision == "f16") {
+        A_f16 = convert_matrix<fp16_t>(A, gemm_float_to_f16);
+        B_f16 = convert_matrix<fp16_t>(B, gemm_float_to_f16);
+    }
+
+    PerfCounters counters;
+    counters.start();
+    auto start = std::chrono::high_resolution_clock::now();
+    int info;
+    if (precision == "bf16")
+        info = gemm_bf16bf16f32('N', 'N', M, N, K, 1.0f, A_bf16.data(), A_bf16.ld(), B_bf16.data(), B_bf16.ld(),
+                               0.0f, C.data(), C.ld());
+    else if (precision == "f16")
+        info = gemm_f16f16f32('N', 'N', M, N, K, 1.0f, A_f16.data(), A_f16.ld(), B_f16.data(), B_f16.ld(),
+                              0.0f, C.data(), C.ld());
+    else
+        info = sgemm('N', 'N', M, N, K, 1.0f, A.data(), A.ld(), B.data(), B.ld(), 0.0f, C.data(), C.ld());
+    auto end = std::chrono::high_resolution_clock::now();
+    counters.stop();
+
+    if (info != 0) {
+        std::cerr << "sgemm: invalid argument " << -info << std::endl;
+        return -1;
+    }
+
+    std::chrono::duration<double> elapsed = end - start;
+    double gflops = 2.0 * M * N * (double)K / elapsed.count() * 1e-9;
+    std::cout << "Matrix multiplication (" << M << " x " << N << " x " << K << ", " << precision << ") completed in "
+              << elapsed.count() << " seconds.\n";
+    std::cout << "Throughput: " << gflops << " GFLOP/s\n";
+    std::cout << "OpenMP threads used: " << omp_get_max_threads() << std::endl;
+    counters.report(std::cout, 2.0 * M * N * (double)K, true);
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+#include "gemm.h"
+#include "matrix.h"
+#include "rng.h"
+#include "sparse.h"
+
+// Sparse A times dense B through the dense engine, CSR and block-CSR SpMM and
+// multiply_auto, then A times a sparse copy of itself through SpGEMM. The
+// sparse kernels run once more split for four threads but granted a team of
+// one (nested in another region), and must give the same results.
+// Usage: ./tiled_mm_sparse [N [density]]   (defaults to 2048 x 2048, 1% nonzeros)
+
+// Element (i, j) is nonzero when word i * cols + j of the seed's stream falls
+// below density * 2^32; nonzeros take values 1-9 from the next seed
+static void fill_sparse(DenseMatrix<float> &mat, uint64_t seed, double density) {
+    const uint32_t cut = (uint32_t)std::min(4294967295.0, density * 4294967296.0);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < mat.rows(); ++i) {
+        float *row = mat.row(i);
+        philox_int(row, mat.cols(), seed + 1, (uint64_t)i * mat.cols(), 1, 9);
+        philox_words(seed, (uint64_t)i * mat.cols(), mat.cols(), [&](size_t j, uint32_t w) {
+            if (w >= cut)
+                row[j] = 0.0f;
+        });
+    }
+}
+
+static double max_abs_diff(const DenseMatrix<float> &X, const DenseMatrix<float> &Y) {
+    double err = 0.0;
+    for (int i = 0; i < X.rows(); ++i)
+        for (int j = 0; j < X.cols(); ++j)
+            err = std::max(err, (double)std::fabs(X(i, j) - Y(i, j)));
+    return err;
+}
+
+// Runs fn on the master of an active two-thread region with nesting off, so
+// every parallel region fn starts gets a team of one whatever it asks for
+template <typename F>
+static void with_one_thread_team(F fn) {
+    const int saved = omp_get_max_active_levels();
+    omp_set_max_active_levels(1);
+    #pragma omp parallel num_threads(2)
+    #pragma omp master
+    fn();
+    omp_set_max_active_levels(saved);
+}
+
+template <typename F>
+static double seconds(F run) {
+    auto start = std::chrono::high_resolution_clock::now();
+    run();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+    int n = 2048;
+    double density = 0.01;
+    if (argc >= 2)
+        n = std::atoi(argv[1]);
+    if (argc >= 3)
+        density = std::atof(argv[2]);
+    if (n <= 0 || density < 0.0 || density > 1.0) {
+        std::cerr << "Usage: ./tiled_mm_sparse [N [density]]" << std::endl;
+        return -1;
+    }
+    const int nt = omp_get_max_threads();
+
+    DenseMatrix<float> A(n, n), B(n, n);
+    fill_sparse(A, 1, density);
+    philox_fill_int(B, 3, 0, 9);
+
+    DenseMatrix<float> C_dense(n, n, 0.0f), C_csr(n, n, 0.0f), C_bsr(n, n, 0.0f), C_auto(n, n, 0.0f);
+    double t_dense = seconds([&] {
+        sgemm('N', 'N', n, n, n, 1.0f, A.data(), A.ld(), B.data(), B.ld(), 0.0f, C_dense.data(), C_dense.ld());
+    });
+    CsrMatrix<float> S;
+    double t_convert = seconds([&] { S = csr_from_dense(A, nt); });
+    BsrMatrix<float> Sb = bsr_from_csr(S);
+    double t_csr = seconds([&] { spmm(S, B, C_csr, nt); });
+    double t_bsr = seconds([&] { spmm(Sb, B, C_bsr, nt); });
+    bool sparse_path = false;
+    double t_auto = seconds([&] { sparse_path = multiply_auto(A, B, C_auto, nt); });
+
+    // SpGEMM: P = S * S, checked against the dense product of A with itself
+    CsrMatrix<float> P;
+    double t_spgemm = seconds([&] { P = spgemm(S, S, nt); });
+    DenseMatrix<float> AA(n, n, 0.0f), P_dense(n, n, 0.0f);
+    sgemm('N', 'N', n, n, n, 1.0f, A.data(), A.ld(), A.data(), A.ld(), 0.0f, AA.data(), AA.ld());
+    for (int i = 0; i < n; ++i)
+        for (int64_t p = P.row_ptr[i]; p < P.row_ptr[i + 1]; ++p)
+            P_dense(i, P.col_idx[p]) = P.values[p];
+
+    const double useful = 2.0 * S.nnz() * n;
+    std::cout << n << " x " << n << " x " << n << ", A density " << S.density() << " (estimate "
+              << estimate_density(A) << "), " << Sb.blocks() << " 4x4 blocks ("
+              << (Sb.blocks() ? (double)S.nnz() / (16.0 * Sb.blocks()) : 0.0) << " filled)\n";
+    std::cout << "dense sgemm:  " << t_dense << " s\n";
+    std::cout << "CSR SpMM:     " << t_csr << " s, " << useful / t_csr * 1e-9 << " useful GFLOP/s (+"
+              << t_convert << " s to convert)\n";
+    std::cout << "BSR SpMM:     " << t_bsr << " s, " << useful / t_bsr * 1e-9 << " useful GFLOP/s\n";
+    std::cout << "auto:         " << t_auto << " s, " << (sparse_path ? "sparse" : "dense") << " path\n";
+    std::cout << "SpGEMM A*A:   " << t_spgemm << " s, " << P.nnz() << " nonzeros\n";
+    std::cout << "Max abs error: CSR " << max_abs_diff(C_csr, C_dense) << ", BSR " << max_abs_diff(C_bsr, C_dense)
+              << ", auto " << max_abs_diff(C_auto, C_dense) << ", SpGEMM " << max_abs_diff(P_dense, AA) << "\n";
+
+    // Four row ranges on a team of one: every range must still be computed
+    DenseMatrix<float> C_csr1(n, n, 0.0f), C_bsr1(n, n, 0.0f);
+    CsrMatrix<float> P1;
+    with_one_thread_team([&] {
+        spmm(S, B, C_csr1, 4);
+        spmm(Sb, B, C_bsr1, 4);
+        P1 = spgemm(S, S, 4);
+    });
+    const bool team_ok = max_abs_diff(C_csr1, C_csr) == 0.0 && max_abs_diff(C_bsr1, C_bsr) == 0.0 &&
+                         P1.row_ptr == P.row_ptr && P1.col_idx == P.col_idx && P1.values == P.values;
+    std::cout << "Reduced team (4 ranges, 1 thread): " << (team_ok ? "identical" : "MISMATCH") << "\n";
+    std::cout << "OpenMP threads used: " << nt << std::endl;
+    return team_ok ? 0 : -1;
+}
@@ -0,0 +1,206 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <sys/mman.h>
+#include "summa.h"
+#include "rng.h"
+
+// Distributed SUMMA multiply of N x N matrices across processes on one host,
+// over shared memory or Unix-domain sockets, as a scaling benchmark. Strong
+// scaling keeps N fixed; weak scaling grows it as N * cbrt(P / P0) so every
+// process keeps the same FLOPs. P runs over layers, 2 * layers, 4 * layers,
+// ... up to max_procs, and each process gets hardware threads / P OpenMP
+// threads. Values of A and B are uniform in [-1, 1); every process checks
+// sampled entries of its C blocks in double.
+// Usage: ./tiled_mm_summa [N] [max_procs] [--transport shm|socket] [--layers C] [--block NB]
+
+struct RankResult {
+    SummaStats stats;
+    double max_err;
+};
+
+// What rank 0 hands back to the parent, in a shared anonymous mapping
+struct Report {
+    double seconds;         // slowest rank
+    double wait_frac;       // mean share of the time spent waiting for panels
+    double comm_frac;       // mean share of the time the communication thread was busy
+    double mbytes;          // sent by all ranks
+    double max_err;
+};
+
+// Fills this process's blocks of a rows x cols matrix; global element (i, j)
+// is word i * cols + j of the seed's Philox stream, as in a whole matrix
+static void fill_local(DenseMatrix<float> &M, int cols, int nb, int procs_r, int coord_r, int procs_c,
+                       int coord_c, uint64_t seed) {
+    for (int li = 0; li < M.rows(); ++li) {
+        const int gi = block_cyclic_global(li, nb, procs_r, coord_r);
+        for (int lj = 0; lj < M.cols(); lj += nb) {
+            const int gj = block_cyclic_global(lj, nb, procs_c, coord_c);
+            philox_uniform(M.row(li) + lj, std::min(nb, M.cols() - lj), seed, (uint64_t)gi * cols + gj, -1.0f,
+                           1.0f);
+        }
+    }
+}
+
+// Max abs error of a 4 x 4 sample of the local C blocks against a double
+// dot product of the generated row of A and column of B
+static double sampled_error(const DenseMatrix<float> &C, int n, int nb, const SummaGrid &g) {
+    std::vector<float> a(n);
+    double max_err = 0.0;
+    for (int si = 0; si < 4; ++si) {
+        const int li = si * (C.rows() - 1) / 3, gi = block_cyclic_global(li, nb, g.rows, g.row);
+        philox_uniform(a.data(), n, 1, (uint64_t)gi * n, -1.0f, 1.0f);
+        for (int sj = 0; sj < 4; ++sj) {
+            const int lj = sj * (C.cols() - 1) / 3, gj = block_cyclic_global(lj, nb, g.cols, g.col);
+            double ref = 0.0;
+            for (int k = 0; k < n; ++k) {
+                float b;
+                philox_uniform(&b, 1, 2, (uint64_t)k * n + gj, -1.0f, 1.0f);
+                ref += (double)a[k] * b;
+            }
+            max_err = std::max(max_err, std::fabs(ref - C(li, lj)));
+        }
+    }
+    return max_err;
+}
+
+// One multiply on procs processes; false when a rank failed
+static bool run(const std::string &transport, int procs, int layers, int n, int nb, int threads, Report *report) {
+    std::unique_ptr<Transport> t = make_transport(transport, procs);
+    int failed = run_ranks(*t, [&](Transport &t) {
+        const SummaGrid g = summa_grid(t.size(), layers, t.rank());
+        DenseMatrix<float> A(summa_local_rows(n, nb, g), summa_local_cols(n, nb, g));
+        DenseMatrix<float> B(summa_local_rows(n, nb, g), summa_local_cols(n, nb, g));
+        DenseMatrix<float> C(summa_local_rows(n, nb, g), summa_local_cols(n, nb, g));
+        if (g.layer == 0) {
+            fill_local(A, n, nb, g.rows, g.row, g.cols, g.col, 1);
+            fill_local(B, n, nb, g.rows, g.row, g.cols, g.col, 2);
+        }
+
+        // One warm-up multiply: page faults, the OpenMP team and the channels
+        RankResult mine;
+        for (int rep = 0; rep < 2; ++rep) {
+            t.barrier();
+            mine.stats = summa_multiply(t, g, n, n, n, nb, A, B, C, threads);
+        }
+        mine.max_err = g.layer == 0 ? sampled_error(C, n, nb, g) : 0.0;
+
+        if (t.rank() != 0) {
+            t.send(0, &mine, sizeof(mine));
+            return 0;
+        }
+        Report r{mine.stats.seconds, mine.stats.wait_s / mine.stats.seconds,
+                 mine.stats.comm_s / mine.stats.seconds, mine.stats.bytes_sent, mine.max_err};
+        for (int src = 1; src < t.size(); ++src) {
+            RankResult other;
+            t.recv(src, &other, sizeof(other));
+            r.seconds = std::max(r.seconds, other.stats.seconds);
+            r.wait_frac += other.stats.wait_s / other.stats.seconds;
+            r.comm_frac += other.stats.comm_s / other.stats.seconds;
+            r.mbytes += other.stats.bytes_sent;
+            r.max_err = std::max(r.max_err, other.max_err);
+        }
+        r.wait_frac /= t.size();
+        r.comm_frac /= t.size();
+        r.mbytes *= 1e-6;
+        *report = r;
+        return 0;
+    });
+    return failed == 0;
+}
+
+static void usage() {
+    std::cerr << "Usage: ./tiled_mm_summa [N] [max_procs] [--transport shm|socket] [--layers C] [--block NB]"
+              << std::endl;
+}
+
+int main(int argc, char **argv) {
+    int N = 1024, max_procs = 4, layers = 1, nb = 128;
+    std::string transport = "shm";
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--transport" && i + 1 < argc) {
+            transport = argv[++i];
+        } else if (arg == "--layers" && i + 1 < argc) {
+            layers = std::atoi(argv[++i]);
+        } else if (arg == "--block" && i + 1 < argc) {
+            nb = std::atoi(argv[++i]);
+        } else if (positional == 0) {
+            N = std::atoi(argv[i]);
+            ++positional;
+        } else if (positional == 1) {
+            max_procs = std::atoi(argv[i]);
+            ++positional;
+        } else {
+            usage();
+            return -1;
+        }
+    }
+    if (N <= 0 || max_procs <= 0 || layers <= 0 || nb <= 0 || layers > max_procs ||
+        (transport != "shm" && transport != "socket")) {
+        usage();
+        return -1;
+    }
+
+    // Shared with the forked ranks; the parent never starts an OpenMP team
+    Report *report = static_cast<Report *>(
+        mmap(nullptr, sizeof(Report), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    if (report == MAP_FAILED) {
+        std::cerr << "Cannot map the report page" << std::endl;
+        return -1;
+    }
+    const int hw = std::max(1u, std::thread::hardware_concurrency());
+
+    std::cout << "Transport: " << transport << ", " << layers << " layer(s), " << nb << " x " << nb
+              << " blocks, " << hw << " hardware threads\n";
+    for (const char *mode : {"strong", "weak"}) {
+        std::cout << "\n" << mode << " scaling\n"
+                  << std::setw(6) << "procs" << std::setw(10) << "grid" << std::setw(7) << "N"
+                  << std::setw(9) << "threads" << std::setw(11) << "seconds" << std::setw(10) << "GFLOP/s"
+                  << std::setw(8) << "eff" << std::setw(8) << "wait" << std::setw(8) << "comm"
+                  << std::setw(10) << "MB sent" << std::setw(11) << "max err\n";
+        double base_gflops = 0.0;
+        for (int procs = layers; procs <= max_procs; procs *= 2) {
+            int n = N;
+            if (std::string(mode) == "weak")
+                n = (int)std::lround(N * std::cbrt((double)procs / layers) / 16) * 16;
+            const SummaGrid g = summa_grid(procs, layers, 0);
+            const int blocks = (n + nb - 1) / nb;
+            const std::string grid = std::to_string(g.rows) + "x" + std::to_string(g.cols) + "x" +
+                                     std::to_string(g.layers);
+            if (blocks < std::max(g.rows, g.cols)) {
+                std::cout << std::setw(6) << procs << std::setw(10) << grid << std::setw(7) << n
+                          << "  skipped: fewer blocks than grid rows or columns\n";
+                continue;
+            }
+            const int threads = std::max(1, hw / procs);
+            if (!run(transport, procs, layers, n, nb, threads, report)) {
+                std::cout << std::setw(6) << procs << std::setw(10) << grid << std::setw(7) << n << "  failed\n";
+                continue;
+            }
+            const double gflops = 2.0 * n * n * (double)n / report->seconds * 1e-9;
+            if (base_gflops == 0.0)
+                base_gflops = gflops;
+            const double efficiency = gflops / (base_gflops * procs / layers);
+            std::cout << std::setw(6) << procs << std::setw(10) << grid << std::setw(7) << n
+                      << std::setw(9) << threads << std::fixed << std::setprecision(4) << std::setw(11)
+                      << report->seconds << std::setprecision(1) << std::setw(10) << gflops << std::setprecision(2)
+                      << std::setw(8) << efficiency << std::setw(8) << report->wait_frac << std::setw(8)
+                      << report->comm_frac << std::setprecision(1) << std::setw(10) << report->mbytes
+                      << std::scientific << std::setprecision(1) << std::setw(11) << report->max_err
+                      << std::defaultfloat << "\n";
+            if (report->max_err > 1e-4 * n) {
+                std::cerr << "Result check failed at N = " << n << " on " << procs << " processes" << std::endl;
+                return -1;
+            }
+        }
+    }
+    munmap(report, sizeof(Report));
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <omp.h>
+#include "matrix.h"
+#include "rng.h"
+#include "transpose.h"
+
+// Transpose bandwidth: the old collapse(2) element loop from matmul.cpp, the
+// blocked out-of-place transpose and the in-place square one.
+// Usage: ./tiled_mm_transpose [rows [cols]]   (defaults to 4096 x 4096)
+
+template <typename F>
+static double seconds(F run) {
+    auto start = std::chrono::high_resolution_clock::now();
+    run();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char **argv) {
+    int rows = 4096, cols = 4096;
+    if (argc >= 2)
+        rows = cols = std::atoi(argv[1]);
+    if (argc >= 3)
+        cols = std::atoi(argv[2]);
+    if (rows <= 0 || cols <= 0) {
+        std::cerr << "Usage: ./tiled_mm_transpose [rows [cols]]" << std::endl;
+        return -1;
+    }
+
+    DenseMatrix<float> A(rows, cols), T_naive(cols, rows, 0.0f), T(cols, rows, 0.0f);
+    philox_fill_uniform(A, 1, 0.0f, 1.0f);
+
+    double t_naive = seconds([&] {
+        #pragma omp parallel for collapse(2) schedule(dynamic)
+        for (int i = 0; i < rows; ++i)
+            for (int j = 0; j < cols; ++j)
+                T_naive(j, i) = A(i, j);
+    });
+    double t_blocked = seconds([&] { transpose(A, T); });
+
+    bool ok = true;
+    for (int i = 0; i < cols && ok; ++i)
+        for (int j = 0; j < rows && ok; ++j)
+            ok = T(i, j) == A(j, i) && T_naive(i, j) == A(j, i);
+
+    // Bytes read plus bytes written
+    const double gb = 2.0 * rows * (double)cols * sizeof(float) / 1e9;
+    std::cout << rows << " x " << cols << " transpose, check " << (ok ? "passed" : "FAILED") << "\n";
+    std::cout << "element loop: " << t_naive << " s, " << gb / t_naive << " GB/s\n";
+    std::cout << "blocked:      " << t_blocked << " s, " << gb / t_blocked << " GB/s"
+              << (transpose_streams(rows, cols, T.data(), T.ld()) ? " (streaming stores)" : "") << "\n";
+    if (rows == cols) {
+        double t_inplace = seconds([&] { transpose_inplace(A); });
+        for (int i = 0; i < rows && ok; ++i)
+            for (int j = 0; j < cols && ok; ++j)
+                ok = A(i, j) == T(i, j);
+        std::cout << "in place:     " << t_inplace << " s, " << gb / t_inplace << " GB/s, check "
+                  << (ok ? "passed" : "FAILED") << "\n";
+    }
+    std::cout << "OpenMP threads used: " << omp_get_max_threads() << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,367 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+// Point-to-point byte transport between the processes of one host, for the
+// distributed GEMM in summa.h:
+//
+//     std::unique_ptr<Transport> t = make_transport("shm", procs);    // or "socket"
+//     run_ranks(*t, [&](Transport &t) { ...; t.send(peer, buf, bytes); ...; return 0; });
+//
+// A transport is created in the parent, then run_ranks forks one process per
+// rank and attaches each child to its rank. Two implementations:
+//
+//   ShmTransport      one POSIX shared-memory segment (shm_open, unlinked as
+//                     soon as it is mapped) holding a single-producer,
+//                     single-consumer byte ring per ordered pair of ranks
+//   SocketTransport   a Unix-domain stream socketpair per pair of ranks
+//
+// send and recv block until the whole message has moved, and messages
+// between two ranks arrive in order. Each rank may have one thread using the
+// transport at a time. broadcast runs a binomial tree over a group of ranks,
+// so a root sends log2(group) copies rather than one per member.
+
+#include <atomic>
+#include <vector>
+#include <string>
+#include <memory>
+#include <new>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <x86intrin.h>
+
+const size_t SHM_CHANNEL_BYTES = (size_t)1 << 20;  // ring per ordered pair; untouched pairs cost no memory
+
+class Transport {
+public:
+    explicit Transport(int size) : size_(size) {
+        if (size < 1)
+            throw std::invalid_argument("Transport: need at least one rank");
+    }
+    virtual ~Transport() = default;
+
+    Transport(const Transport &) = delete;
+    Transport &operator=(const Transport &) = delete;
+
+    virtual const char *name() const = 0;
+
+    // Binds this process to a rank; called once in each child after fork
+    virtual void attach(int rank) { rank_ = rank; }
+
+    int rank() const { return rank_; }
+    int size() const { return size_; }
+    uint64_t bytes_sent() const { return bytes_sent_; }
+
+    void send(int dest, const void *data, size_t bytes) {
+        check_peer(dest);
+        send_bytes(dest, data, bytes);
+        bytes_sent_ += bytes;
+    }
+
+    void recv(int src, void *data, size_t bytes) {
+        check_peer(src);
+        recv_bytes(src, data, bytes);
+    }
+
+    // Every rank waits until all have arrived: gather to rank 0, then release
+    void barrier() {
+        char token = 0;
+        if (rank_ == 0) {
+            for (int r = 1; r < size_; ++r)
+                recv(r, &token, 1);
+            for (int r = 1; r < size_; ++r)
+                send(r, &token, 1);
+        } else {
+            send(0, &token, 1);
+            recv(0, &token, 1);
+        }
+    }
+
+protected:
+    virtual void send_bytes(int dest, const void *data, size_t bytes) = 0;
+    virtual void recv_bytes(int src, void *data, size_t bytes) = 0;
+
+private:
+    void check_peer(int peer) const {
+        if (peer < 0 || peer >= size_ || peer == rank_)
+            throw std::invalid_argument("Transport: bad peer rank " + std::to_string(peer));
+    }
+
+    int size_;
+    int rank_ = 0;
+    uint64_t bytes_sent_ = 0;
+};
+
+namespace transport_detail {
+
+// Spin briefly, then yield, then sleep: a waiting rank must not starve the
+// ranks it waits for when processes outnumber cores
+inline void backoff(int &round) {
+    if (round < 64) {
+        _mm_pause();
+    } else if (round < 4096) {
+        sched_yield();
+    } else {
+        timespec ts{0, 50000};
+        nanosleep(&ts, nullptr);
+    }
+    ++round;
+}
+
+struct alignas(64) ShmChannel {
+    std::atomic<uint64_t> head{0};          // bytes ever written, by the sender only
+    alignas(64) std::atomic<uint64_t> tail{0};  // bytes ever read, by the receiver only
+};
+
+}  // namespace transport_detail
+
+class ShmTransport : public Transport {
+public:
+    explicit ShmTransport(int size, size_t channel_bytes = SHM_CHANNEL_BYTES)
+        : Transport(size), capacity_(channel_bytes) {
+        static std::atomic<int> serial{0};
+        const std::string name = "/tiled_mm_" + std::to_string(::getpid()) + "_" + std::to_string(serial++);
+        bytes_ = (size_t)size * size * stride();
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0)
+            throw std::runtime_error("cannot create shared memory " + name);
+        if (::ftruncate(fd, (off_t)bytes_) != 0) {
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            throw std::runtime_error("cannot size shared memory " + name);
+        }
+        base_ = static_cast<char *>(::mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        ::close(fd);
+        ::shm_unlink(name.c_str());     // the mapping, inherited across fork, keeps it alive
+        if (base_ == MAP_FAILED)
+            throw std::runtime_error("cannot map shared memory " + name);
+        for (int from = 0; from < size; ++from)
+            for (int to = 0; to < size; ++to)
+                if (from != to)
+                    new (channel(from, to)) transport_detail::ShmChannel;
+    }
+
+    ~ShmTransport() override {
+        if (base_ != MAP_FAILED)
+            ::munmap(base_, bytes_);
+    }
+
+    const char *name() const override { return "shm"; }
+
+protected:
+    void send_bytes(int dest, const void *data, size_t bytes) override {
+        transport_detail::ShmChannel *ch = channel(rank(), dest);
+        char *ring = ring_of(ch);
+        const char *src = static_cast<const char *>(data);
+        uint64_t head = ch->head.load(std::memory_order_relaxed);
+        while (bytes > 0) {
+            size_t space;
+            int round = 0;
+            while ((space = capacity_ - (size_t)(head - ch->tail.load(std::memory_order_acquire))) == 0)
+                transport_detail::backoff(round);
+            const size_t at = head % capacity_;
+            // At most a quarter ring at a time, so the receiver copies out while the next one goes in
+            const size_t chunk = std::min({bytes, space, capacity_ - at, capacity_ / 4});
+            std::memcpy(ring + at, src, chunk);
+            head += chunk;
+            ch->head.store(head, std::memory_order_release);
+            src += chunk;
+            bytes -= chunk;
+        }
+    }
+
+    void recv_bytes(int src, void *data, size_t bytes) override {
+        transport_detail::ShmChannel *ch = channel(src, rank());
+        const char *ring = ring_of(ch);
+        char *dst = static_cast<char *>(data);
+        uint64_t tail = ch->tail.load(std::memory_order_relaxed);
+        while (bytes > 0) {
+            size_t ready;
+            int round = 0;
+            while ((ready = (size_t)(ch->head.load(std::memory_order_acquire) - tail)) == 0)
+                transport_detail::backoff(round);
+            const size_t at = tail % capacity_;
+            const size_t chunk = std::min({bytes, ready, capacity_ - at});
+            std::memcpy(dst, ring + at, chunk);
+            tail += chunk;
+            ch->tail.store(tail, std::memory_order_release);
+            dst += chunk;
+            bytes -= chunk;
+        }
+    }
+
+private:
+    size_t stride() const { return sizeof(transport_detail::ShmChannel) + capacity_; }
+
+    transport_detail::ShmChannel *channel(int from, int to) const {
+        return reinterpret_cast<transport_detail::ShmChannel *>(base_ + ((size_t)from * size() + to) * stride());
+    }
+
+    static char *ring_of(transport_detail::ShmChannel *ch) { return reinterpret_cast<char *>(ch + 1); }
+
+    size_t capacity_;
+    size_t bytes_ = 0;
+    char *base_ = static_cast<char *>(MAP_FAILED);
+};
+
+class SocketTransport : public Transport {
+public:
+    explicit SocketTransport(int size) : Transport(size), fds_((size_t)size * size, -1) {
+        for (int a = 0; a < size; ++a)
+            for (int b = a + 1; b < size; ++b) {
+                int pair[2];
+                if (::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                    close_all();
+                    throw std::runtime_error("cannot create socketpair: " + std::string(std::strerror(errno)));
+                }
+                fds_[(size_t)a * size + b] = pair[0];   // a's end towards b
+                fds_[(size_t)b * size + a] = pair[1];
+            }
+    }
+
+    ~SocketTransport() override { close_all(); }
+
+    const char *name() const override { return "socket"; }
+
+    // Keeps only this rank's ends
+    void attach(int rank) override {
+        Transport::attach(rank);
+        for (int a = 0; a < size(); ++a)
+            for (int b = 0; b < size(); ++b)
+                if (a != rank && fd(a, b) >= 0) {
+                    ::close(fd(a, b));
+                    fds_[(size_t)a * size() + b] = -1;
+                }
+    }
+
+protected:
+    void send_bytes(int dest, const void *data, size_t bytes) override {
+        const char *src = static_cast<const char *>(data);
+        while (bytes > 0) {
+            ssize_t sent = ::send(fd(rank(), dest), src, bytes, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR)
+                continue;
+            if (sent <= 0)
+                throw std::runtime_error("send to rank " + std::to_string(dest) + " failed");
+            src += sent;
+            bytes -= (size_t)sent;
+        }
+    }
+
+    void recv_bytes(int src, void *data, size_t bytes) override {
+        char *dst = static_cast<char *>(data);
+        while (bytes > 0) {
+            ssize_t got = ::recv(fd(rank(), src), dst, bytes, MSG_WAITALL);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                throw std::runtime_error("recv from rank " + std::to_string(src) + " failed");
+            dst += got;
+            bytes -= (size_t)got;
+        }
+    }
+
+private:
+    int fd(int from, int to) const { return fds_[(size_t)from * size() + to]; }
+
+    void close_all() {
+        for (int &f : fds_)
+            if (f >= 0) {
+                ::close(f);
+                f = -1;
+            }
+    }
+
+    std::vector<int> fds_;
+};
+
+// "shm" or "socket"; throws std::invalid_argument for anything else
+inline std::unique_ptr<Transport> make_transport(const std::string &kind, int size) {
+    if (kind == "shm")
+        return std::unique_ptr<Transport>(new ShmTransport(size));
+    if (kind == "socket")
+        return std::unique_ptr<Transport>(new SocketTransport(size));
+    throw std::invalid_argument("unknown transport " + kind + " (shm or socket)");
+}
+
+// Binomial-tree broadcast of bytes at data from group[root] to every member
+// of group. Every member calls it with the same group and root; the caller
+// must be in the group.
+inline void broadcast(Transport &t, const std::vector<int> &group, int root, void *data, size_t bytes) {
+    const int size = (int)group.size();
+    const int me = (int)(std::find(group.begin(), group.end(), t.rank()) - group.begin());
+    if (me == size)
+        throw std::invalid_argument("broadcast: rank " + std::to_string(t.rank()) + " is not in the group");
+    const int rel = (me - root + size) % size;
+    int mask = 1;
+    for (; mask < size; mask <<= 1)
+        if (rel & mask) {
+            t.recv(group[(rel - mask + root) % size], data, bytes);
+            break;
+        }
+    for (mask >>= 1; mask > 0; mask >>= 1)
+        if (rel + mask < size)
+            t.send(group[(rel + mask + root) % size], data, bytes);
+}
+
+// Forks one process per rank; each attaches to its rank and exits with
+// fn(transport) as its status (1 if fn throws). When a rank fails the others
+// are killed, since they may be blocked on it. Returns the number of failed
+// ranks. Call it before the parent starts an OpenMP team: libgomp's threads
+// do not survive fork.
+template <typename Fn>
+inline int run_ranks(Transport &t, Fn fn) {
+    std::cout.flush();
+    std::cerr.flush();
+    std::vector<pid_t> pids;
+    for (int r = 0; r < t.size(); ++r) {
+        pid_t pid = ::fork();
+        if (pid < 0) {
+            for (pid_t p : pids)
+                ::kill(p, SIGKILL);
+            for (pid_t p : pids)
+                ::waitpid(p, nullptr, 0);
+            throw std::runtime_error("fork failed");
+        }
+        if (pid == 0) {
+            int status = 1;
+            try {
+                t.attach(r);
+                status = fn(t);
+            } catch (const std::exception &e) {
+                std::cerr << "rank " << r << ": " << e.what() << std::endl;
+            }
+            std::cout.flush();
+            ::_exit(status);
+        }
+        pids.push_back(pid);
+    }
+
+    int failed = 0;
+    for (size_t left = pids.size(); left > 0; --left) {
+        int status = 0;
+        pid_t pid = ::wait(&status);
+        if (pid < 0)
+            break;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            if (failed++ == 0)
+                for (pid_t p : pids)
+                    if (p != pid)
+                        ::kill(p, SIGKILL);
+        }
+    }
+    return failed;
+}
+
+#endif
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <string>
+#include <cstdlib>
+#include <omp.h>
+#include "gemm.h"
+#include "autotune.h"
+
+// Tunes the packed engine's blocking for this machine, calibrates the cost
+// model sgemm plans thread counts with, and stores both in the per-CPU-model
+// config file that sgemm loads on its first call. Then searches the tile
+// edges of the cache-tiled loop nests, which the tiled programs load at
+// startup, into the same entry.
+//
+// Usage: ./tune [--size N] [--trials T] [--passes P] [--file PATH] [--show | --calibrate]
+int main(int argc, char **argv) {
+    AutotuneOptions opt;
+    std::string path = tune_file_path();
+    bool show_only = false, calibrate_only = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "--size" && has_value) opt.size = std::atoi(argv[++i]);
+        else if (arg == "--trials" && has_value) opt.trials = std::atoi(argv[++i]);
+        else if (arg == "--passes" && has_value) opt.passes = std::atoi(argv[++i]);
+        else if (arg == "--file" && has_value) path = argv[++i];
+        else if (arg == "--show") show_only = true;
+        else if (arg == "--calibrate") calibrate_only = true;
+        else {
+            std::cerr << "Usage: ./tune [--size N] [--trials T] [--passes P] [--file PATH] [--show | --calibrate]\n";
+            return -1;
+        }
+    }
+
+    std::string model = cpu_model();
+    CacheInfo caches = detect_caches();
+    std::cout << "CPU: " << model << "\n"
+              << "Caches: L1d " << caches.l1d / 1024 << " KB, L2 " << caches.l2 / 1024
+              << " KB, L3 " << caches.l3 / 1024 << " KB, line " << caches.line << " B\n"
+              << "Microkernel: " << gemm_mr() << " x " << gemm_nr()
+              << ", OpenMP threads: " << omp_get_max_threads() << "\n";
+
+    GemmConfig cfg;
+    if (show_only) {
+        bool tuned = load_config(path, model, cfg);
+        if (!tuned)
+            cfg = model_config(caches);
+        std::cout << (tuned ? "Tuned" : "Model") << " config: kc=" << cfg.kc << " mc=" << cfg.mc
+                  << " nc=" << cfg.nc << " order=" << (cfg.loop_order == LOOP_IR_JR ? "ir_jr" : "jr_ir")
+                  << "\n";
+        GemmCostModel cost;
+        bool calibrated = load_cost_model(path, model, cost);
+        if (!calibrated)
+            cost = gemm_default_cost_model();
+        std::cout << (calibrated ? "Calibrated" : "Default") << " cost model: fork/join " << cost.fork_join_us
+                  << " us, sgemm " << cost.core_gflops << " GFLOP/s per thread, " << cost.socket_gflops
+                  << " GFLOP/s all threads, read " << cost.core_gbs << " GB/s per thread, " << cost.socket_gbs
+                  << " GB/s all threads\n";
+        TileConfig tiles = default_tile_config();
+        bool tiles_tuned = load_tiles(path, model, tiles);
+        std::cout << (tiles_tuned ? "Tuned" : "Default") << " tile edges: tile=" << tiles.tile << " l1=" << tiles.l1
+                  << " l2=" << tiles.l2 << " l3=" << tiles.l3 << "\n";
+        return 0;
+    }
+
+    if (calibrate_only) {
+        if (load_config(path, model, cfg))
+            gemm_set_config(cfg);
+    } else {
+        double gflops = 0.0;
+        cfg = autotune(opt, &gflops);
+        if (!save_config(path, model, cfg)) {
+            std::cerr << "Cannot write " << path << std::endl;
+            return -1;
+        }
+        std::cout << "Saved kc=" << cfg.kc << " mc=" << cfg.mc << " nc=" << cfg.nc
+                  << " order=" << (cfg.loop_order == LOOP_IR_JR ? "ir_jr" : "jr_ir")
+                  << " (" << gflops << " GFLOP/s at n=" << opt.size << ") to " << path << std::endl;
+    }
+
+    // After the search, so core_gflops is measured with the winning blocking
+    GemmCostModel cost = calibrate_cost_model(true);
+    if (!save_cost_model(path, model, cost)) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return -1;
+    }
+    std::cout << "Saved cost model to " << path << std::endl;
+    if (calibrate_only)
+        return 0;
+
+    TileConfig tiles = autotune_tiles(opt);
+    if (!save_tiles(path, model, tiles)) {
+        std::cerr << "Cannot write " << path << std::endl;
+        return -1;
+    }
+    std::cout << "Saved tile=" << tiles.tile << " l1=" << tiles.l1 << " l2=" << tiles.l2 << " l3=" << tiles.l3
+              << " to " << path << std::endl;
+    return 0;
+}